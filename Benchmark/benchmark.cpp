@@ -0,0 +1,108 @@
+#include "benchmark.h"
+
+#include "BlockStore/column_vector.h"
+
+
+using namespace BlockStore;
+
+
+struct Point {
+	double x;
+	double y;
+	double z;
+	uint64 id;
+};
+
+struct Record {
+	uint64 id;
+	std::string name;
+	std::vector<double> value_list;
+};
+
+constexpr auto layout(layout_type<Record>) { return declare(&Record::id, &Record::name, &Record::value_list); }
+
+using Value = std::variant<uint64, std::string, std::vector<double>>;
+
+struct TreeNode {
+	std::string text;
+	std::vector<BlockRef<TreeNode>> child_list;
+};
+
+constexpr auto layout(layout_type<TreeNode>) { return declare(&TreeNode::text, &TreeNode::child_list); }
+
+
+std::string MakeText(data_t index) { return "text " + std::to_string(index * 7919); }
+
+TreeNode MakeTreeNode(BlockManager& manager, data_t child_count) {
+	std::vector<data_t> index_list(child_count);
+	for (data_t index = 0; index < child_count; ++index) { index_list[index] = (index + 3) * sizeof(data_t); }
+	BlockLoadContext context(manager, (const byte*)index_list.data(), child_count * sizeof(data_t));
+	TreeNode node; node.text = MakeText(child_count); node.child_list.resize(child_count);
+	for (auto& child : node.child_list) { Load(context, child); }
+	return node;
+}
+
+void RunAll(Benchmark& benchmark) {
+	benchmark.Run("trivial", Point{ 1.0, 2.0, 3.0, 4 });
+	benchmark.Run("trivial_vector", std::vector<Point>(1024, Point{ 1.0, 2.0, 3.0, 4 }));
+
+	Record record{ 42, "record", std::vector<double>(64, 0.5) };
+	benchmark.Run("custom", record);
+	benchmark.Run("custom_vector", std::vector<Record>(64, record));
+	benchmark.Run("custom_column", column_vector<Record>(64, record));
+
+	std::vector<std::string> string_list(256); for (data_t index = 0; index < string_list.size(); ++index) { string_list[index] = MakeText(index); }
+	benchmark.Run("string_vector", string_list);
+	benchmark.Run("string_column", column_vector<std::string>(string_list.begin(), string_list.end()));
+
+	std::map<std::string, Record> record_map; for (data_t index = 0; index < 64; ++index) { record_map.emplace(MakeText(index), record); }
+	benchmark.Run("string_map", record_map);
+	std::unordered_map<uint64, uint64> id_map; for (data_t index = 0; index < 1024; ++index) { id_map.emplace(index * 7919, index); }
+	benchmark.Run("unordered_map", id_map);
+
+	std::vector<std::vector<Value>> variant_list(16);
+	for (data_t index = 0; index < 16 * 16; ++index) {
+		auto& value_list = variant_list[index % 16];
+		switch (index % 3) {
+		case 0: value_list.emplace_back((uint64)index); break;
+		case 1: value_list.emplace_back(MakeText(index)); break;
+		case 2: value_list.emplace_back(std::vector<double>(8, (double)index)); break;
+		}
+	}
+	benchmark.Run("nested_variant", variant_list);
+
+	std::array<std::string, 8> string_array; for (data_t index = 0; index < string_array.size(); ++index) { string_array[index] = MakeText(index); }
+	benchmark.Run("string_array", string_array);
+
+	benchmark.Run("block_ref", MakeTreeNode(benchmark.GetBlockManager(), 64));
+}
+
+
+int main(int argc, const char* argv[]) {
+	std::string baseline_path = (std::filesystem::path(__FILE__).parent_path() / "baseline.txt").string();  // next to the project, whatever the working directory
+	double threshold = 0.2;
+	bool update = false;
+	for (int index = 1; index < argc; ++index) {
+		std::string arg = argv[index];
+		if (arg == "--update") { update = true; continue; }
+		if (arg.rfind("--threshold=", 0) == 0) { threshold = std::stod(arg.substr(12)); continue; }
+		baseline_path = arg;
+	}
+
+	Benchmark benchmark;
+	RunAll(benchmark);
+	benchmark.Print(std::cout);
+
+	if (update) {
+		if (!benchmark.SaveBaseline(baseline_path)) { std::cout << "save baseline error: " << baseline_path << std::endl; return 1; }
+		std::cout << "baseline recorded: " << baseline_path << std::endl;
+		return 0;
+	}
+	if (!std::ifstream(baseline_path)) { std::cout << "baseline missing: " << baseline_path << " (record it with --update)" << std::endl; return 1; }
+	if (!benchmark.CheckBaseline(baseline_path, threshold, std::cout)) { return 1; }
+	std::cout << "baseline passed: " << baseline_path << std::endl;
+	return 0;
+}
+
+
+#pragma comment(lib, "BlockStore.lib")
\ No newline at end of file
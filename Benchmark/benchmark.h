@@ -0,0 +1,151 @@
+#pragma once
+
+#include "BlockStore/block_manager.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <filesystem>
+#include <iostream>
+#include <iomanip>
+#include <limits>
+#include <algorithm>
+
+
+BEGIN_NAMESPACE(BlockStore)
+
+
+class MemoryFile : public BlockFile {
+public:
+	virtual bool IsReadOnly() const override { return false; }
+	virtual uint64 GetSize() const override { return 0; }
+	virtual void SetSize(uint64 size) override { throw std::runtime_error("memory file is not resizable"); }
+	virtual bool Refresh() override { return false; }
+public:
+	virtual uint64 GetSegmentSize() const override { return 0; }
+	virtual byte* Lock(uint64 offset, uint64 length) const override { throw std::runtime_error("memory file has no content"); }
+	virtual void Unlock(uint64 offset, uint64 length, bool dirty) const override {}
+	virtual void Flush() override {}
+public:
+	virtual AccessPattern GetAccessPattern() const override { return AccessPattern::Normal; }
+	virtual void SetAccessPattern(AccessPattern pattern) override {}
+	virtual void Advise(uint64 offset, uint64 length, AccessPattern pattern) const override {}
+};
+
+
+struct BenchmarkResult {
+	std::string name;
+	data_t size = 0;
+	double size_ns = 0;
+	double save_ns = 0;
+	double load_ns = 0;
+	double save_gbps = 0;
+	double load_gbps = 0;
+};
+
+
+class Benchmark {
+private:
+	using clock = std::chrono::steady_clock;
+	static constexpr data_t batch_count = 256;
+	static constexpr data_t repeat_count = 5;
+	static constexpr double min_seconds = 0.05;
+private:
+	BlockManager manager;
+	std::vector<BenchmarkResult> result_list;
+	volatile data_t sink;
+public:
+	Benchmark() : manager(std::make_unique<MemoryFile>()), sink(0) {}
+public:
+	BlockManager& GetBlockManager() { return manager; }
+	const std::vector<BenchmarkResult>& GetResultList() const { return result_list; }
+private:
+	template<class Func>
+	static double Measure(Func func) {
+		double best = std::numeric_limits<double>::max();
+		for (data_t repeat = 0; repeat < repeat_count; ++repeat) {  // best of several runs to filter scheduling noise
+			data_t round = 0; double seconds = 0; clock::time_point begin = clock::now();
+			do { func(); ++round; seconds = std::chrono::duration<double>(clock::now() - begin).count(); } while (seconds < min_seconds);
+			best = std::min(best, seconds * 1e9 / (round * batch_count));
+		}
+		return best;
+	}
+public:
+	template<class T>
+	void Run(const std::string& name, const T& object) {
+		BenchmarkResult result; result.name = name;
+		BlockSizeContext size_context; Size(size_context, object);
+		data_t size = size_context.GetSize(); align_offset<data_t>(size); result.size = size;
+		std::vector<data_t> buffer(size / sizeof(data_t) * batch_count);
+		auto block = [&](data_t index) { return (byte*)buffer.data() + size * index; };
+		std::vector<T> object_list(batch_count);
+
+		result.size_ns = Measure([&]() {
+			for (data_t index = 0; index < batch_count; ++index) {
+				BlockSizeContext context; Size(context, object); sink = sink + context.GetSize();
+			}
+		});
+		result.save_ns = Measure([&]() {
+			for (data_t index = 0; index < batch_count; ++index) {
+				BlockSaveContext context(manager, block(index), size); Save(context, object);
+			}
+		});
+		result.load_ns = Measure([&]() {
+			for (data_t index = 0; index < batch_count; ++index) {
+				BlockLoadContext context(manager, block(index), size); Load(context, object_list[index]);
+			}
+			sink = sink + (data_t)&object_list.back();
+		});
+		result.save_gbps = size / result.save_ns;
+		result.load_gbps = size / result.load_ns;
+		result_list.push_back(result);
+	}
+
+	// report
+public:
+	void Print(std::ostream& out) const {
+		out << std::left << std::setw(24) << "name" << std::right << std::setw(10) << "bytes"
+			<< std::setw(12) << "size ns" << std::setw(12) << "save ns" << std::setw(12) << "load ns"
+			<< std::setw(12) << "save GB/s" << std::setw(12) << "load GB/s" << std::endl;
+		out << std::fixed << std::setprecision(2);
+		for (auto& result : result_list) {
+			out << std::left << std::setw(24) << result.name << std::right << std::setw(10) << result.size
+				<< std::setw(12) << result.size_ns << std::setw(12) << result.save_ns << std::setw(12) << result.load_ns
+				<< std::setw(12) << result.save_gbps << std::setw(12) << result.load_gbps << std::endl;
+		}
+	}
+
+	// baseline
+public:
+	bool SaveBaseline(const std::string& path) const {
+		std::ofstream file(path); if (!file) { return false; }
+		for (auto& result : result_list) { file << result.name << ' ' << result.save_gbps << ' ' << result.load_gbps << '\n'; }
+		return (bool)file;
+	}
+	bool LoadBaseline(const std::string& path, std::map<std::string, std::pair<double, double>>& baseline) const {
+		std::ifstream file(path); if (!file) { return false; }
+		std::string name; double save_gbps, load_gbps;
+		while (file >> name >> save_gbps >> load_gbps) { baseline[name] = { save_gbps, load_gbps }; }
+		return true;
+	}
+	bool CheckBaseline(const std::string& path, double threshold, std::ostream& out) const {
+		std::map<std::string, std::pair<double, double>> baseline;
+		if (!LoadBaseline(path, baseline)) { throw std::runtime_error("load baseline error"); }
+		bool passed = true;
+		auto check = [&](const std::string& name, const char* phase, double current, double base) {
+			if (current >= base * (1 - threshold)) { return; }
+			out << "regression: " << name << ' ' << phase << ' ' << current << " GB/s < " << base << " GB/s" << std::endl; passed = false;
+		};
+		for (auto& result : result_list) {
+			auto it = baseline.find(result.name); if (it == baseline.end()) { continue; }
+			check(result.name, "save", result.save_gbps, it->second.first);
+			check(result.name, "load", result.load_gbps, it->second.second);
+		}
+		return passed;
+	}
+};
+
+
+END_NAMESPACE(BlockStore)
\ No newline at end of file
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "block_manager.h"
+
+#include <coroutine>
+#include <exception>
+
+
+BEGIN_NAMESPACE(BlockStore)
+
+
+template<class T>
+class BlockReadAwaiter {
+private:
+	ref_ptr<BlockManager> manager;
+	data_t index;
+	BlockPtr<const T> block;
+	std::exception_ptr exception;
+public:
+	BlockReadAwaiter(BlockManager& manager, data_t index) : manager(&manager), index(index) {}
+public:
+	bool await_ready() {
+		block = manager->ReadCachedBlock<T>(index); return static_cast<bool>(block);
+	}
+	void await_suspend(std::coroutine_handle<> handle) {
+		manager->SubmitRead([this, handle]() {
+			try {
+				block = manager->GetBlock<T>(index);
+			} catch (...) {
+				exception = std::current_exception();
+			}
+			handle.resume();
+		});
+	}
+	BlockPtr<const T> await_resume() {
+		if (exception != nullptr) { std::rethrow_exception(exception); }
+		return std::move(block);
+	}
+};
+
+
+template<class T>
+inline BlockReadAwaiter<T> BlockRef<T>::ReadAsync() const {
+	if (manager == nullptr) { throw std::invalid_argument("block ref uninitialized"); }
+	return BlockReadAwaiter<T>(*manager, index);
+}
+
+
+END_NAMESPACE(BlockStore)
\ No newline at end of file
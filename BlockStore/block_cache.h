@@ -1,24 +1,162 @@
 #pragma once
 
-#include "core.h"
+#include "block_pool.h"
+#include "block_node.h"
+#include "epoch.h"
 
 #include <memory>
+#include <atomic>
 #include <unordered_map>
 #include <vector>
+#include <array>
+#include <algorithm>
+#include <shared_mutex>
+#include <future>
 
 
 BEGIN_NAMESPACE(BlockStore)
 
 
 class BlockCache {
+public:
+	BlockCache() {}
+	~BlockCache() {
+		for (Shard& shard : shard_list) {
+			for (auto& slot : shard.table_holder->slot_list) { delete slot.load(); }
+			for (BlockNode* node : shard.detached_list) { delete node; }
+			for (auto& [epoch, node] : shard.retired_node_list) { delete node; }
+		}
+	}
+
 	// const block cache
 private:
-	std::unordered_map<data_t, std::weak_ptr<void>> const_block_cache;
+	static constexpr uint shard_bits = 6;
+	static constexpr data_t shard_count = (data_t)1 << shard_bits;
+	static constexpr data_t initial_table_size = 16;
+	static constexpr data_t reclaim_threshold = 64;
+	static uint64 hash(data_t index) { return (uint64)(index / sizeof(data_t)) * 0x9E3779B97F4A7C15ull; }
+	struct Table {
+		std::vector<std::atomic<ref_ptr<BlockNode>>> slot_list;
+		Table(data_t size) : slot_list(size) {}
+		data_t Home(data_t index) const { return (data_t)(hash(index) >> 24) & (slot_list.size() - 1); }
+		data_t Next(data_t slot) const { return (slot + 1) & (slot_list.size() - 1); }
+	};
+	struct alignas(64) Shard {
+		std::shared_mutex mutex;  // hits probe the table under an epoch guard instead
+		std::unique_ptr<Table> table_holder = std::make_unique<Table>(initial_table_size);
+		std::atomic<ref_ptr<Table>> table = table_holder.get();
+		data_t count = 0;
+		std::unordered_map<data_t, std::shared_future<void>> loading_map;
+		std::vector<ref_ptr<BlockNode>> detached_list;  // evicted nodes, deleted on their last release
+		std::vector<std::pair<uint64, ref_ptr<BlockNode>>> retired_node_list;  // unlinked nodes a guarded reader may still see
+		std::vector<std::pair<uint64, std::unique_ptr<Table>>> retired_table_list;
+
+		data_t Probe(data_t index) const {
+			const Table& table = *this->table.load(std::memory_order_relaxed); data_t slot = table.Home(index);
+			for (ref_ptr<BlockNode> node; (node = table.slot_list[slot].load(std::memory_order_relaxed)) != nullptr && node->index != index; ) { slot = table.Next(slot); }
+			return slot;
+		}
+		ref_ptr<BlockNode> Get(data_t slot) const { return table.load(std::memory_order_relaxed)->slot_list[slot].load(std::memory_order_relaxed); }
+		ref_ptr<BlockNode> Find(data_t index) const { return Get(Probe(index)); }
+		void Insert(ref_ptr<BlockNode> node) {
+			if ((count + 1) * 2 > table.load(std::memory_order_relaxed)->slot_list.size()) {
+				std::unique_ptr<Table> new_table = std::make_unique<Table>(table_holder->slot_list.size() * 2);
+				for (auto& slot : table_holder->slot_list) {
+					if (ref_ptr<BlockNode> old_node = slot.load(std::memory_order_relaxed); old_node != nullptr) {
+						data_t new_slot = new_table->Home(old_node->index);
+						while (new_table->slot_list[new_slot].load(std::memory_order_relaxed) != nullptr) { new_slot = new_table->Next(new_slot); }
+						new_table->slot_list[new_slot].store(old_node, std::memory_order_relaxed);
+					}
+				}
+				table.store(new_table.get());  // published whole, the old table stays readable until reclaimed
+				retired_table_list.emplace_back(EpochDomain::GetEpoch(), std::move(table_holder)); table_holder = std::move(new_table);
+			}
+			table_holder->slot_list[Probe(node->index)].store(node); ++count;
+		}
+		void Erase(data_t slot) {
+			Table& table = *table_holder; data_t hole = slot;
+			for (data_t next = table.Next(hole); table.slot_list[next].load(std::memory_order_relaxed) != nullptr; next = table.Next(next)) {
+				ref_ptr<BlockNode> node = table.slot_list[next].load(std::memory_order_relaxed); data_t home = table.Home(node->index);
+				if (((next - home) & (table.slot_list.size() - 1)) >= ((next - hole) & (table.slot_list.size() - 1))) { table.slot_list[hole].store(node); hole = next; }
+			}
+			table.slot_list[hole].store(nullptr); --count;  // a reader racing the shift may miss, never sees a freed node
+		}
+		void Retire(ref_ptr<BlockNode> node, std::vector<ref_ptr<BlockNode>>& reclaimed_list) {
+			retired_node_list.emplace_back(EpochDomain::GetEpoch(), node);
+			if (retired_node_list.size() + retired_table_list.size() < reclaim_threshold) { return; }
+			uint64 safe_epoch = EpochDomain::Synchronize();
+			for (auto& [epoch, retired_node] : retired_node_list) { if (epoch < safe_epoch) { reclaimed_list.push_back(retired_node); retired_node = nullptr; } }
+			retired_node_list.erase(std::remove_if(retired_node_list.begin(), retired_node_list.end(), [](auto& entry) { return entry.second == nullptr; }), retired_node_list.end());
+			retired_table_list.erase(std::remove_if(retired_table_list.begin(), retired_table_list.end(), [=](auto& entry) { return entry.first < safe_epoch; }), retired_table_list.end());
+		}
+	};
+	std::array<Shard, shard_count> shard_list;
+private:
+	Shard& GetShard(data_t index) { return shard_list[hash(index) >> (64 - shard_bits)]; }
+	ref_ptr<BlockNode> FindBlock(Shard& shard, data_t index) {
+		EpochDomain::Guard guard; if (!guard.IsActive()) { return nullptr; }
+		const Table* table = shard.table.load(); data_t slot = table->Home(index); ref_ptr<BlockNode> node;
+		while ((node = table->slot_list[slot].load()) != nullptr && node->index != index) { slot = table->Next(slot); }
+		if (node == nullptr || !node->TryAddRef()) { return nullptr; }  // a node at count 0 may be on its way out
+		if (shard.table.load() == table && table->slot_list[slot].load() == node) { return node; }
+		if (node->Release()) { ReleaseBlock(index, node); }  // evicted or moved meanwhile
+		return nullptr;
+	}
 public:
-	bool IsBlockCached(data_t index) { return const_block_cache.find(index) != const_block_cache.end(); }
-	void SetBlock(data_t index, std::weak_ptr<void> weak_ptr) { const_block_cache.emplace(index, weak_ptr); }
-	std::shared_ptr<void> GetBlock(data_t index) { return const_block_cache.at(index).lock(); }
-	void CheckBlock(data_t index) { if (const_block_cache.at(index).expired()) { const_block_cache.erase(index); } }
+	ref_ptr<BlockNode> GetBlock(data_t index) {
+		Shard& shard = GetShard(index);
+		if (ref_ptr<BlockNode> node = FindBlock(shard, index); node != nullptr) { return node; }
+		std::shared_lock<std::shared_mutex> lock(shard.mutex);
+		ref_ptr<BlockNode> node = shard.Find(index); if (node != nullptr) { node->AddRef(); }
+		return node;
+	}
+	template<class Loader>
+	ref_ptr<BlockNode> GetBlock(data_t index, Loader loader) {
+		while (true) {
+			Shard& shard = GetShard(index);
+			if (ref_ptr<BlockNode> node = FindBlock(shard, index); node != nullptr) { return node; }
+			std::unique_lock<std::shared_mutex> lock(shard.mutex);
+			if (ref_ptr<BlockNode> node = shard.Find(index); node != nullptr) { node->AddRef(); return node; }
+			if (auto it = shard.loading_map.find(index); it != shard.loading_map.end()) {
+				std::shared_future<void> future = it->second; lock.unlock(); future.get(); continue;
+			}
+			std::promise<void> promise; shard.loading_map.emplace(index, promise.get_future().share()); lock.unlock();
+			ref_ptr<BlockNode> node;
+			try {
+				node = loader();
+			} catch (...) {
+				lock.lock(); shard.loading_map.erase(index); lock.unlock();
+				promise.set_exception(std::current_exception()); throw;
+			}
+			lock.lock(); shard.Insert(node); shard.loading_map.erase(index); lock.unlock();
+			promise.set_value(); return node;
+		}
+	}
+	void ReleaseBlock(data_t index, ref_ptr<BlockNode> node) {
+		Shard& shard = GetShard(index); std::unique_lock<std::shared_mutex> lock(shard.mutex);
+		data_t slot = shard.Probe(index);
+		if (shard.Get(slot) == node) {
+			if (node->ref_count.load(std::memory_order_acquire) != 0) { return; }
+			shard.Erase(slot);
+		} else {
+			auto it = std::find(shard.detached_list.begin(), shard.detached_list.end(), node);
+			if (it == shard.detached_list.end() || node->ref_count.load(std::memory_order_acquire) != 0) { return; }
+			shard.detached_list.erase(it);
+		}
+		std::vector<ref_ptr<BlockNode>> reclaimed_list; shard.Retire(node, reclaimed_list);
+		lock.unlock(); for (BlockNode* reclaimed_node : reclaimed_list) { delete reclaimed_node; }
+	}
+	void EvictBlock(data_t index) {
+		Shard& shard = GetShard(index); std::unique_lock<std::shared_mutex> lock(shard.mutex);
+		data_t slot = shard.Probe(index); ref_ptr<BlockNode> node = shard.Get(slot); if (node == nullptr) { return; }
+		shard.Erase(slot); shard.detached_list.push_back(node);  // even at count 0 a release is pending and deletes it
+	}
+
+	// new block pool
+private:
+	BlockPool block_pool;
+public:
+	BlockPool& GetBlockPool() { return block_pool; }
 
 	// new block cache
 private:
@@ -30,16 +168,19 @@ private:
 			data_t const_block_index;
 		};
 		std::shared_ptr<void> block_data;
+		const void* block_type = nullptr;
+		data_t footprint = 0;
 	};
 	std::vector<BlockInfo> new_block_cache;
 	data_t next_index = block_index_invalid;
+	data_t new_block_footprint = 0;
 private:
 	BlockInfo& AllocateBlockEntry() {
 		if (next_index == block_index_invalid) { next_index = new_block_cache.size(); new_block_cache.emplace_back(); }
 		BlockInfo& info = new_block_cache[next_index]; std::swap(info.index, next_index); return info;
 	}
 	void DeallocateBlockEntry(data_t index) {
-		BlockInfo& info = new_block_cache[index]; info.block_data.reset();
+		BlockInfo& info = new_block_cache[index]; info.block_data.reset(); info.block_type = nullptr; SetNewBlockFootprint(index, 0);
 		info.next_index = next_index; next_index = index;
 	}
 private:
@@ -47,13 +188,14 @@ private:
 		if (index >= new_block_cache.size()) { throw std::runtime_error("invalid new block index"); }
 	}
 public:
-	data_t AddNewBlock(std::shared_ptr<void> ptr) {
+	data_t AddNewBlock(std::shared_ptr<void> ptr, const void* type) {
 		BlockInfo& info = AllocateBlockEntry();
-		data_t index = info.index; info.block_data = ptr; info.ref_count = 1;
+		data_t index = info.index; info.block_data = ptr; info.block_type = type; info.ref_count = 1;
 		return index;
 	}
-	std::shared_ptr<void> GetNewBlock(data_t index) {
+	std::shared_ptr<void> GetNewBlock(data_t index, const void* type) {
 		VerifyIndex(index);
+		if (new_block_cache[index].block_type != type) { throw std::runtime_error("pointer type mismatch"); }
 		return new_block_cache[index].block_data;
 	}
 	void IncRefNewBlock(data_t index) {
@@ -72,13 +214,24 @@ public:
 		VerifyIndex(index);
 		new_block_cache[index].const_block_index = block_index;
 		new_block_cache[index].block_data.reset();
+		SetNewBlockFootprint(index, 0);
+	}
+	bool IsNewBlockPinned(data_t index) {
+		VerifyIndex(index);
+		return new_block_cache[index].ref_count != 1 || new_block_cache[index].block_data.use_count() != 1;
 	}
+	data_t GetNewBlockEntryCount() const { return new_block_cache.size(); }
+	bool IsNewBlockLive(data_t index) const { return new_block_cache[index].block_type != nullptr && new_block_cache[index].block_data != nullptr; }
+	const void* GetNewBlockType(data_t index) const { return new_block_cache[index].block_type; }
+	const void* GetNewBlockData(data_t index) const { return new_block_cache[index].block_data.get(); }
+	void SetNewBlockFootprint(data_t index, data_t size) { BlockInfo& info = new_block_cache[index]; new_block_footprint += size - info.footprint; info.footprint = size; }
+	data_t GetNewBlockFootprint() const { return new_block_footprint; }
 	data_t GetSavedBlockIndex(data_t index) {
 		VerifyIndex(index);
 		return new_block_cache[index].const_block_index;
 	}
 	void ClearNewBlock() {
-		new_block_cache.clear(); next_index = block_index_invalid;
+		new_block_cache.clear(); next_index = block_index_invalid; new_block_footprint = 0; block_pool.Release();
 	}
 };
 
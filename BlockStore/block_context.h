@@ -2,10 +2,17 @@
 
 #include "block_layout.h"
 
+#include <vector>
+#include <algorithm>
+#include <optional>
+#include <memory_resource>
+
 
 BEGIN_NAMESPACE(BlockStore)
 
 class BlockManager;
+struct BlockTypeInfo;
+struct BlockScanContext;
 
 
 template<class T>
@@ -27,25 +34,55 @@ constexpr void align_offset(byte*& data) {
 
 
 struct BlockSizeContext {
+private:
+	friend class BlockManager;
+private:
+	struct RefInfo {
+		ref_ptr<BlockManager> manager;
+		ref_ptr<data_t> index;
+		ref_ptr<const BlockTypeInfo> type;
+	};
+	struct LogicalRefInfo {
+		data_t id;
+		ref_ptr<const BlockTypeInfo> type;
+	};
 private:
 	data_t size;
+	ref_ptr<std::vector<RefInfo>> ref_list;
+	ref_ptr<std::vector<LogicalRefInfo>> logical_ref_list;
 public:
-	BlockSizeContext() : size(0) {}
+	BlockSizeContext() : size(0), ref_list(nullptr), logical_ref_list(nullptr) {}
+private:
+	BlockSizeContext(std::vector<RefInfo>& ref_list) : size(0), ref_list(&ref_list), logical_ref_list(nullptr) {}
+	BlockSizeContext(std::vector<RefInfo>& ref_list, std::vector<LogicalRefInfo>& logical_ref_list) :
+		size(0), ref_list(&ref_list), logical_ref_list(&logical_ref_list) {
+	}
 public:
 	template<class T> void add(const T&) { align_offset<T>(size); size += sizeof(T); }
 	template<class T> void add(T object[], data_t count) { align_offset<T>(size); size += sizeof(T) * count; }
+	void add_ref(ref_ptr<BlockManager> manager, data_t& index, const BlockTypeInfo& type) {
+		add(index); if (ref_list != nullptr) { ref_list->push_back({ manager, &index, &type }); }
+	}
+	void add_logical_ref(data_t id, const BlockTypeInfo& type) {
+		add(id); if (logical_ref_list != nullptr) { logical_ref_list->push_back({ id, &type }); }
+	}
 public:
 	data_t GetSize() const { return size; }
 };
 
 
 struct BlockLoadContext {
+private:
+	using arena_t = std::optional<std::pmr::monotonic_buffer_resource>;
 private:
 	BlockManager& manager;
 	const byte* curr;
 	const byte* end;
+	ref_ptr<arena_t> arena;
 public:
-	BlockLoadContext(BlockManager& manager, const byte* begin, data_t length) : manager(manager), curr(begin), end(begin + length) {}
+	BlockLoadContext(BlockManager& manager, const byte* begin, data_t length, ref_ptr<arena_t> arena = nullptr) :
+		manager(manager), curr(begin), end(begin + length), arena(arena) {
+	}
 private:
 	void CheckNextOffset(const byte* offset) { if (offset > end) { throw std::runtime_error("block size mismatch"); } }
 public:
@@ -59,24 +96,28 @@ public:
 		align_offset<T>(curr); const byte* next = curr + sizeof(T) * count; CheckNextOffset(next);
 		memcpy(object, curr, sizeof(T) * count); curr = next;
 	}
+	template<class T>
+	const T* view(data_t count) {
+		align_offset<T>(curr); const byte* next = curr + sizeof(T) * count; CheckNextOffset(next);
+		const T* object = reinterpret_cast<const T*>(curr); curr = next; return object;
+	}
 public:
 	BlockManager& GetBlockManager() const { return manager; }
+	std::pmr::memory_resource* GetMemoryResource() {
+		if (arena == nullptr) { return std::pmr::get_default_resource(); }
+		if (!arena->has_value()) { arena->emplace(std::max<data_t>((end - curr) * 2, 256)); }  // decoded containers outgrow their encoding
+		return &**arena;
+	}
 };
 
 
 struct BlockSaveContext {
-private:
-	friend class BlockManager;
 private:
 	BlockManager& manager;
-	data_t index;
-	byte* begin;
-	byte* end;
 	byte* curr;
+	byte* end;
 public:
-	BlockSaveContext(BlockManager& manager, data_t index, byte* begin, data_t length) :
-		manager(manager), index(index), begin(begin), end(begin + length), curr(begin) {
-	}
+	BlockSaveContext(BlockManager& manager, byte* begin, data_t length) : manager(manager), curr(begin), end(begin + length) {}
 private:
 	void CheckNextOffset(const byte* offset) { if (offset > end) { throw std::runtime_error("block size mismatch"); } }
 public:
@@ -90,9 +131,22 @@ public:
 		align_offset<T>(curr); byte* next = curr + sizeof(T) * count; CheckNextOffset(next);
 		memcpy(curr, object, sizeof(T) * count); curr = next;
 	}
+	template<class T>
+	T* view(data_t count) {
+		align_offset<T>(curr); byte* next = curr + sizeof(T) * count; CheckNextOffset(next);
+		T* object = reinterpret_cast<T*>(curr); curr = next; return object;
+	}
 public:
 	BlockManager& GetBlockManager() const { return manager; }
 };
 
 
+struct BlockTypeInfo {
+	void(*size)(BlockSizeContext& context, const void* block);
+	void(*save)(BlockManager& manager, data_t& index);
+	void(*write)(BlockSaveContext& context, const void* block);
+	void(*scan)(BlockManager& manager, BlockScanContext& context, data_t index);
+};
+
+
 END_NAMESPACE(BlockStore)
\ No newline at end of file
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "uncopyable.h"
+
+#include <cstring>
+
+
+BEGIN_NAMESPACE(BlockStore)
+
+
+class ABSTRACT_BASE BlockFile : Uncopyable {
+public:
+	enum class AccessPattern : uint {
+		Normal = 0,					// default paging
+		Sequential = 1,				// prefetch the range ahead of a scan
+		Random = 2,					// trim the range from the working set after point lookups
+		Populate = 3,				// prefetch the range, and the whole file again after each remap
+	};
+public:
+	virtual ~BlockFile() {}
+public:
+	virtual bool IsReadOnly() const pure;
+	virtual uint64 GetSize() const pure;
+	virtual void SetSize(uint64 size) pure;
+	virtual bool Refresh() pure;
+public:
+	virtual uint64 GetSegmentSize() const pure;  // 0 if the file is a single extent
+	virtual byte* Lock(uint64 offset, uint64 length) const pure;
+	virtual void Unlock(uint64 offset, uint64 length, bool dirty) const pure;
+	virtual void Flush() pure;
+	virtual void ReadUncached(uint64 offset, void* data, uint64 length) const { Read(offset, data, length); }  // sees another process's latest write
+public:
+	virtual AccessPattern GetAccessPattern() const pure;
+	virtual void SetAccessPattern(AccessPattern pattern) pure;
+	virtual void Advise(uint64 offset, uint64 length, AccessPattern pattern) const pure;
+
+	// extent
+public:
+	uint64 AlignExtent(uint64 offset, uint64 length) const {
+		uint64 segment_size = GetSegmentSize(); if (segment_size == 0) { return offset; }
+		if (length > segment_size) { throw std::runtime_error("block exceeds segment size"); }
+		if (offset / segment_size != (offset + length - 1) / segment_size) { offset = (offset / segment_size + 1) * segment_size; }
+		return offset;
+	}
+	template<class Func>
+	void ForEachExtent(uint64 offset, uint64 length, Func func) const {
+		uint64 segment_size = GetSegmentSize();
+		while (length > 0) {
+			uint64 extent = segment_size == 0 ? length : segment_size - offset % segment_size; if (extent > length) { extent = length; }
+			func(offset, extent); offset += extent; length -= extent;
+		}
+	}
+	void Read(uint64 offset, void* data, uint64 length) const {
+		ForEachExtent(offset, length, [&](uint64 begin, uint64 extent) {
+			memcpy((byte*)data + (begin - offset), Lock(begin, extent), extent); Unlock(begin, extent, false);
+		});
+	}
+	void Write(uint64 offset, const void* data, uint64 length) const {
+		ForEachExtent(offset, length, [&](uint64 begin, uint64 extent) {
+			memcpy(Lock(begin, extent), (const byte*)data + (begin - offset), extent); Unlock(begin, extent, true);
+		});
+	}
+};
+
+
+class BlockFileLock : Uncopyable {
+private:
+	const BlockFile& file;
+	const uint64 offset;
+	const uint64 length;
+	const bool dirty;
+	byte* const data;
+public:
+	BlockFileLock(const BlockFile& file, uint64 offset, uint64 length, bool dirty = false) :
+		file(file), offset(offset), length(length), dirty(dirty), data(file.Lock(offset, length)) {
+	}
+	~BlockFileLock() { file.Unlock(offset, length, dirty); }
+public:
+	byte* GetData() const { return data; }
+	uint64 GetLength() const { return length; }
+};
+
+
+END_NAMESPACE(BlockStore)
\ No newline at end of file
@@ -29,4 +29,14 @@ template<class T>
 constexpr bool has_trivial_layout = std::is_trivial_v<T> && !has_custom_layout<T>;
 
 
+template<class T, class = void>
+constexpr bool has_fixed_layout = has_trivial_layout<T>;
+
+template<class... Ts>
+constexpr bool all_fixed_layout(std::tuple<Ts...>) { return (has_fixed_layout<Ts> && ...); }
+
+template<class T>
+constexpr bool has_fixed_layout<T, std::enable_if_t<has_custom_layout<T>>> = all_fixed_layout(member_type_tuple(layout(layout_type<T>())));
+
+
 END_NAMESPACE(BlockStore)
\ No newline at end of file
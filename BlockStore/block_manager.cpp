@@ -1,74 +1,835 @@
 #include "block_manager.h"
 #include "file_manager.h"
 #include "block_cache.h"
+#include "thread_pool.h"
+
+#include <filesystem>
 
 
 BEGIN_NAMESPACE(BlockStore)
 
+BEGIN_NAMESPACE(Anonymous)
+
+constexpr data_t parallel_save_block_count = 256;
+
+constexpr data_t bulk_reserve_size = 64 * 1024 * 1024;
+
+constexpr data_t logical_page_cache_size = 64;
+
+constexpr data_t writer_extent_size = 1024 * 1024;
+
+struct HotSetHeader {
+	data_t file_size;
+	data_t root_index;
+	uint64 root_hash;  // tells a reformatted store from the one the set was recorded on
+};
+
+struct HotSetEntry {
+	data_t index;
+	data_t length;
+	uint64 type_hash;
+};
+
+class WriterFile : public BlockFile {
+private:
+	BlockFile& file;
+public:
+	WriterFile(BlockFile& file) : file(file) {}
+public:
+	virtual bool IsReadOnly() const override { return file.IsReadOnly(); }
+	virtual uint64 GetSize() const override { return file.GetSize(); }
+	virtual void SetSize(uint64 size) override { throw std::runtime_error("concurrent writer cannot resize the file"); }
+	virtual bool Refresh() override { return false; }
+public:
+	virtual uint64 GetSegmentSize() const override { return file.GetSegmentSize(); }
+	virtual byte* Lock(uint64 offset, uint64 length) const override { return file.Lock(offset, length); }
+	virtual void Unlock(uint64 offset, uint64 length, bool dirty) const override { file.Unlock(offset, length, dirty); }
+	virtual void Flush() override {}  // the parent flushes at commit
+public:
+	virtual AccessPattern GetAccessPattern() const override { return file.GetAccessPattern(); }
+	virtual void SetAccessPattern(AccessPattern pattern) override {}
+	virtual void Advise(uint64 offset, uint64 length, AccessPattern pattern) const override { file.Advise(offset, length, pattern); }
+};
+
+struct RedoRecordHeader {
+	data_t index;
+	data_t length;
+	uint64 hash;
+};
+
+constexpr data_t redo_log_reserve_size = 64 * 1024;
+
+struct ChangeSegmentHeader {
+	data_t begin;
+	data_t end;
+	MetaInfo meta_info;
+};
+
+uint64 hash_block(const byte* data, data_t size) {
+	uint64 hash = 0x9E3779B97F4A7C15ull ^ size;
+	for (data_t offset = 0; offset < size; offset += sizeof(uint64)) {
+		uint64 word; memcpy(&word, data + offset, sizeof(uint64));
+		hash = (hash ^ word) * 0xFF51AFD7ED558CCDull; hash ^= hash >> 32;
+	}
+	return hash;
+}
+
+std::wstring change_segment_path(const std::wstring& directory, data_t begin) {
+	wchar name[32]; swprintf(name, 32, L"%016llx.seg", (uint64)begin);
+	return (std::filesystem::path(directory) / name).wstring();
+}
+
+END_NAMESPACE(Anonymous)
+
+
+struct BlockScanContext {
+	ThreadPool& thread_pool;
+	TaskGroup group;
+	std::vector<std::atomic<uint64>> visited_map;
+	std::function<void(data_t index, data_t length)> visitor;
+	std::function<void(data_t index, const char* message)> handler;
+	std::atomic<bool> stopped = false;  // set once the handler throws, queued blocks are skipped
+
+	BlockScanContext(ThreadPool& thread_pool, data_t file_size) :
+		thread_pool(thread_pool), visited_map((file_size / sizeof(data_t) + 63) / 64) {
+	}
+
+	void Report(data_t index, const char* message) {
+		try {
+			handler(index, message);
+		} catch (...) {
+			stopped = true; throw;
+		}
+	}
+};
 
-BlockManager::BlockManager(std::unique_ptr<FileManager> file) : file(std::move(file)), cache(new BlockCache) { 
+
+BlockManager::BlockManager(std::unique_ptr<BlockFile> file) :
+	file(std::move(file)), read_only(this->file != nullptr && this->file->IsReadOnly()), cache(new BlockCache) {
 	if (this->file == nullptr) { throw std::invalid_argument("invalid file manager"); }
 	LoadMetaInfo(); 
 }
 
-BlockManager::~BlockManager() {}
+BlockManager::BlockManager(BlockManager& parent) :
+	file(new WriterFile(*parent.file)), read_only(parent.read_only), cache(new BlockCache) {
+	if (!parent.IsConcurrentWriting()) { throw std::runtime_error("concurrent write not started"); }
+	this->parent = &parent; meta_info = parent.meta_info;
+	placement_policy = parent.placement_policy; cluster_size = parent.cluster_size;
+}
+
+BlockManager::~BlockManager() {
+	WaitRead();
+	try { SaveHotSet(); } catch (std::exception&) {}
+	ReleaseWarmSet();
+}
+
+data_t BlockManager::GetFileSize() const { return file->GetSize(); }
 
 void BlockManager::LoadMetaInfo() {
 	if (file->GetSize() >= meta_info_size) {
-		byte* data = file->Lock(0, meta_info_size);
-		memcpy(&meta_info, data, meta_info_size);
+		file->Read(0, &meta_info, meta_info_size);
 	}
 }
 
 void BlockManager::SaveMetaInfo() {
 	meta_info.file_size = file->GetSize();
-	byte* data = file->Lock(0, meta_info_size);
-	memcpy(data, &meta_info, meta_info_size);
+	file->Write(0, &meta_info, meta_info_size);
+	file->Flush();
+	TruncateRedoLog();
 }
 
 void BlockManager::Format() {
+	CheckWritable(); CheckRootOwner();
+	if (IsConcurrentWriting()) { throw std::runtime_error("concurrent write in progress"); }
 	file->SetSize(meta_info_size);
 	meta_info.root_index = block_index_invalid;
+	meta_info.fingerprint_index = block_index_invalid;
+	meta_info.logical_index = block_index_invalid;
+	fingerprint_map.clear(); fingerprint_loaded = true;
+	ResetLogicalTable();
+	spill_begin = block_index_invalid;
 	SaveMetaInfo();
 }
 
-bool BlockManager::IsBlockCached(data_t index) { return cache->IsBlockCached(index); }
-void BlockManager::SetCachedBlock(data_t index, std::weak_ptr<void> weak_ptr) { return cache->SetBlock(index, weak_ptr); }
-std::shared_ptr<void> BlockManager::GetCachedBlock(data_t index) { return cache->GetBlock(index); }
-void BlockManager::CheckCachedBlock(data_t index) { return cache->CheckBlock(index); }
+bool BlockManager::Refresh() {
+	if (!read_only) { throw std::runtime_error("block manager is not read only"); }
+	if (file->GetSize() < meta_info_size && (!file->Refresh() || file->GetSize() < meta_info_size)) { return false; }
+	MetaInfo latest; file->ReadUncached(0, &latest, meta_info_size);  // a plain memory read through a mapped view
+	if (latest.file_size == meta_info.file_size && latest.root_index == meta_info.root_index) { return false; }
+	if (latest.file_size < meta_info.file_size) { throw std::runtime_error("store truncated by writer"); }
+	if (latest.root_index != block_index_invalid && latest.root_index >= latest.file_size) { return false; }
+	if (latest.logical_index != block_index_invalid && latest.logical_index >= latest.file_size) { return false; }
+	if (latest.file_size > file->GetSize()) { file->Refresh(); if (latest.file_size > file->GetSize()) { return false; } }
+	meta_info = latest;
+	ResetLogicalTable();
+	return true;
+}
 
-data_t BlockManager::AddNewBlock(std::shared_ptr<void> ptr) { return convert_new_block_index_from_cache(cache->AddNewBlock(ptr)); }
-std::shared_ptr<void> BlockManager::GetNewBlock(data_t index) { return cache->GetNewBlock(convert_new_block_index_to_cache(index)); }
+ref_ptr<BlockNode> BlockManager::GetCachedBlock(data_t index) { return cache->GetBlock(index); }
+ref_ptr<BlockNode> BlockManager::GetCachedBlock(data_t index, block_loader loader) { return cache->GetBlock(index, [&]() { return loader(*this, index); }); }
+void BlockManager::ReleaseCachedBlock(data_t index, ref_ptr<BlockNode> node) { return cache->ReleaseBlock(index, node); }
+void BlockManager::EvictCachedBlock(data_t index) { return cache->EvictBlock(index); }
+
+BlockPool& BlockManager::GetBlockPool() { return cache->GetBlockPool(); }
+data_t BlockManager::AddNewBlock(std::shared_ptr<void> ptr, const void* type) { return convert_new_block_index_from_cache(cache->AddNewBlock(ptr, type)); }
+std::shared_ptr<void> BlockManager::GetNewBlock(data_t index, const void* type) { return cache->GetNewBlock(convert_new_block_index_to_cache(index), type); }
 void BlockManager::IncRefNewBlock(data_t index) { return cache->IncRefNewBlock(convert_new_block_index_to_cache(index)); }
 void BlockManager::DecRefNewBlock(data_t index) { return cache->DecRefNewBlock(convert_new_block_index_to_cache(index)); }
 bool BlockManager::IsNewBlockSaved(data_t index) { return cache->IsNewBlockSaved(convert_new_block_index_to_cache(index)); }
 void BlockManager::SaveNewBlock(data_t index, data_t block_index) { return cache->SaveNewBlock(convert_new_block_index_to_cache(index), block_index); }
 data_t BlockManager::GetSavedBlockIndex(data_t index) {	return cache->GetSavedBlockIndex(convert_new_block_index_to_cache(index));}
-void BlockManager::ClearNewBlock() { return cache->ClearNewBlock(); }
+data_t BlockManager::GetNewBlockFootprint() { return cache->GetNewBlockFootprint(); }
+void BlockManager::ChargeNewBlock(data_t index) {
+	if (memory_budget == block_index_invalid) { return; }
+	data_t cache_index = convert_new_block_index_to_cache(index);
+	BlockSizeContext size_context; static_cast<const BlockTypeInfo*>(cache->GetNewBlockType(cache_index))->size(size_context, cache->GetNewBlockData(cache_index));
+	cache->SetNewBlockFootprint(cache_index, size_context.GetSize());
+}
+void BlockManager::ClearNewBlock() { cache->ClearNewBlock(); spill_threshold = memory_budget; spill_begin = block_index_invalid; }
+
+void BlockManager::SubmitRead(std::function<void()> task) {
+	std::lock_guard<std::mutex> lock(io_mutex);
+	if (io_pool == nullptr) { io_pool.reset(io_thread_count > 0 ? new ThreadPool(io_thread_count) : new ThreadPool); io_group.reset(new TaskGroup); }
+	io_pool->Submit(*io_group, std::move(task));
+}
+
+void BlockManager::WaitRead() {
+	if (io_pool != nullptr) { io_pool->Wait(*io_group); }
+}
+
+void BlockManager::SetIOThreadCount(uint thread_count) {
+	WaitRead(); io_pool.reset(); io_group.reset(); io_thread_count = thread_count;
+}
+
+uint64 BlockManager::HashTypeName(const char* name) {
+	uint64 hash = 0xCBF29CE484222325ull;
+	for (; *name != '\0'; ++name) { hash = (hash ^ (uchar)*name) * 0x100000001B3ull; }
+	return hash;
+}
+
+void BlockManager::SelectHotList(std::vector<std::pair<data_t, HotBlockInfo>>& hot_list, data_t capacity) {
+	auto hot_end = hot_list.begin() + std::min<data_t>(hot_list.size(), capacity);
+	std::nth_element(hot_list.begin(), hot_end, hot_list.end(), [](auto& a, auto& b) { return a.second.count > b.second.count; });
+	hot_list.erase(hot_end, hot_list.end());
+}
+
+std::vector<std::pair<data_t, BlockManager::HotBlockInfo>> BlockManager::GetHotList() {
+	std::vector<std::pair<data_t, HotBlockInfo>> hot_list;
+	for (HotShard& shard : hot_shard_list) {
+		std::shared_lock<std::shared_mutex> lock(shard.mutex);
+		for (auto& [index, counter] : shard.hot_map) { hot_list.push_back({ index, { counter.type_hash, counter.count } }); }
+	}
+	SelectHotList(hot_list, hot_set_capacity);
+	return hot_list;
+}
+
+void BlockManager::RecordHotBlock(data_t index, uint64 type_hash) {
+	HotShard& shard = hot_shard_list[(index / sizeof(data_t)) % hot_shard_count];
+	auto count = [type_hash](HotCounter& counter) {
+		if (counter.type_hash.load(std::memory_order_relaxed) != type_hash) { counter.type_hash.store(type_hash, std::memory_order_relaxed); }
+		counter.count.fetch_add(1, std::memory_order_relaxed);
+	};
+	{
+		std::shared_lock<std::shared_mutex> lock(shard.mutex);
+		if (auto it = shard.hot_map.find(index); it != shard.hot_map.end()) { return count(it->second); }
+	}
+	std::lock_guard<std::shared_mutex> lock(shard.mutex);
+	count(shard.hot_map.try_emplace(index).first->second);
+	if (data_t capacity = hot_set_capacity; shard.hot_map.size() > capacity * 2) {  // halving lets blocks that turned hot overtake ones that cooled down
+		std::vector<std::pair<data_t, HotBlockInfo>> hot_list;
+		for (auto& [block_index, counter] : shard.hot_map) {
+			if (uint64 aged_count = counter.count / 2; aged_count > 0) { hot_list.push_back({ block_index, { counter.type_hash, aged_count } }); }
+		}
+		SelectHotList(hot_list, capacity);
+		shard.hot_map.clear();
+		for (auto& [block_index, info] : hot_list) { HotCounter& counter = shard.hot_map[block_index]; counter.type_hash = info.type_hash; counter.count = info.count; }
+	}
+}
+
+uint64 BlockManager::HashCommittedBlock(data_t index) {
+	if (!is_const_block_index(index) || index < meta_info_size || index + sizeof(data_t) > GetFileSize()) { return 0; }
+	data_t length; file->Read(index, &length, sizeof(data_t)); if (length > GetFileSize() - index - sizeof(data_t)) { return 0; }
+	BlockFileLock lock = LockBlock(index); return hash_block(lock.GetData(), lock.GetLength());
+}
+
+void BlockManager::SaveHotSet() {
+	if (hot_set_path.empty() || hot_set_capacity == 0) { return; }
+	HotSetHeader header = { meta_info.file_size, meta_info.root_index, HashCommittedBlock(meta_info.root_index) };
+	std::vector<HotSetEntry> entry_list;
+	for (auto& [index, info] : GetHotList()) {
+		if (index + sizeof(data_t) > GetFileSize()) { continue; }
+		data_t length; file->Read(index, &length, sizeof(data_t)); entry_list.push_back({ index, length, info.type_hash });
+	}
+	std::sort(entry_list.begin(), entry_list.end(), [](auto& a, auto& b) { return a.index < b.index; });  // warmed in file order
+	std::wstring temp_path = hot_set_path + L".tmp";
+	{
+		FileManager hot_set(temp_path.c_str(), FileManager::CreateMode::CreateAlways);
+		hot_set.SetSize(sizeof(HotSetHeader) + entry_list.size() * sizeof(HotSetEntry));
+		hot_set.Write(0, &header, sizeof(HotSetHeader));
+		if (!entry_list.empty()) { hot_set.Write(sizeof(HotSetHeader), entry_list.data(), entry_list.size() * sizeof(HotSetEntry)); }
+	}
+	std::filesystem::rename(temp_path, hot_set_path);
+}
 
-BlockLoadContext BlockManager::LoadBlockContext(data_t index) {
-	byte* data_length = file->Lock(index, sizeof(data_t));
-	data_t length; memcpy(&length, data_length, sizeof(data_t));
-	byte* data_block = file->Lock(index + sizeof(data_t), length);
-	return BlockLoadContext(*this, data_block, length);
+void BlockManager::WarmBlocks(std::unordered_map<uint64, block_loader> loader_map, bool wait) {
+	if (hot_set_path.empty() || !std::filesystem::exists(hot_set_path)) { return; }
+	std::vector<HotSetEntry> entry_list;
+	{
+		FileManager hot_set(hot_set_path.c_str(), FileManager::CreateMode::OpenExisting, FileManager::AccessMode::ReadOnly, FileManager::ShareMode::ReadOnly);
+		if (hot_set.GetSize() < sizeof(HotSetHeader)) { return; }
+		HotSetHeader header; hot_set.Read(0, &header, sizeof(HotSetHeader));
+		if (meta_info.file_size < header.file_size || HashCommittedBlock(header.root_index) != header.root_hash) { return; }  // shrunk or reformatted
+		entry_list.resize((hot_set.GetSize() - sizeof(HotSetHeader)) / sizeof(HotSetEntry));
+		if (!entry_list.empty()) { hot_set.Read(sizeof(HotSetHeader), entry_list.data(), entry_list.size() * sizeof(HotSetEntry)); }
+	}
+	SubmitRead([this, entry_list = std::move(entry_list), loader_map = std::move(loader_map)]() {
+		for (const HotSetEntry& entry : entry_list) {
+			if (!is_const_block_index(entry.index) || entry.index < meta_info_size || entry.index + sizeof(data_t) + entry.length > GetFileSize()) { continue; }
+			data_t length; file->Read(entry.index, &length, sizeof(data_t)); if (length != entry.length) { continue; }  // stale hot set
+			auto it = loader_map.find(entry.type_hash);
+			if (it == loader_map.end()) { file->Advise(entry.index, sizeof(data_t) + length, BlockFile::AccessPattern::Sequential); continue; }
+			try {
+				ref_ptr<BlockNode> node = GetCachedBlock(entry.index, it->second);
+				std::lock_guard<std::mutex> lock(warm_mutex); warm_list.push_back(node);
+			} catch (std::exception&) {}
+		}
+	});
+	if (wait) { WaitRead(); }
+}
+
+bool BlockManager::DropWarmBlock(ref_ptr<BlockNode> node) {
+	{
+		std::lock_guard<std::mutex> lock(warm_mutex);
+		auto it = std::find(warm_list.begin(), warm_list.end(), node); if (it == warm_list.end()) { return false; }
+		warm_list.erase(it);
+	}
+	EvictCachedBlock(node->index);
+	ReleaseNode(node); ReleaseNode(node);  // the warm set's reference and the caller's
+	return true;
+}
+
+void BlockManager::ReleaseWarmSet() {
+	WaitRead();
+	std::vector<ref_ptr<BlockNode>> node_list;
+	{ std::lock_guard<std::mutex> lock(warm_mutex); node_list.swap(warm_list); }
+	for (ref_ptr<BlockNode> node : node_list) { ReleaseNode(node); }
+}
+
+BlockFileLock BlockManager::LockBlock(data_t index) {
+	data_t length; file->Read(index, &length, sizeof(data_t));
+	return BlockFileLock(*file, index + sizeof(data_t), length);
+}
+
+ThreadPool& BlockManager::GetThreadPool() {
+	if (thread_pool == nullptr) { thread_pool.reset(new ThreadPool); }
+	return *thread_pool;
 }
 
 data_t BlockManager::AllocateBlock(data_t size) {
-	data_t offset = file->GetSize();
-	file->SetSize(offset + sizeof(data_t) + size);
+	if (parent != nullptr) { return AllocateWriterBlock(size); }
+	data_t offset = file->AlignExtent(file->GetSize() + allocation_size, sizeof(data_t) + size);
+	allocation_size = offset + sizeof(data_t) + size - file->GetSize();
 	return offset;
 }
 
-BlockSaveContext BlockManager::SaveBlockContext(data_t index, data_t size) {
-	byte* data_block = file->Lock(index, sizeof(data_t) + size);
-	memcpy(data_block, &size, sizeof(data_t));
-	return BlockSaveContext(*this, index, data_block + sizeof(data_t), size);
+void BlockManager::FlushSavedBlocks() {
+	if (!dedup_buffer.empty()) { return FlushDedupBlocks(); }
+	if (save_list.empty()) { return; }
+	if (parent == nullptr) { file->SetSize(file->GetSize() + allocation_size); allocation_size = 0; }
+	auto write_blocks = [&](data_t save_begin, data_t save_end) {
+		for (data_t save_index = save_begin; save_index < save_end; ++save_index) {
+			BlockSaveInfo& info = save_list[save_index];
+			BlockFileLock lock(*file, info.index, sizeof(data_t) + info.size, true);
+			byte* data_block = lock.GetData(); memcpy(data_block, &info.size, sizeof(data_t));
+			BlockSaveContext context(*this, data_block + sizeof(data_t), info.size); info.type->write(context, info.block.get());
+		}
+	};
+	if (save_list.size() < parallel_save_block_count || parent != nullptr) {  // writers already run in parallel
+		write_blocks(0, save_list.size());
+	} else {
+		GetThreadPool().ParallelFor(save_list.size(), write_blocks);
+	}
+	save_list.clear();
+}
+
+void BlockManager::SaveRef(data_t ref_index) {
+	BlockSizeContext::RefInfo ref = save_ref_list[ref_index];
+	if (ref.manager != this) { throw std::invalid_argument("block manager mismatch"); }
+	ref.type->save(*this, *ref.index);
+}
+
+void BlockManager::SaveRefs(data_t ref_begin) {
+	if (placement_policy == PlacementPolicy::BreadthFirst) {
+		for (data_t ref_index = ref_begin; ref_index < save_ref_list.size(); ++ref_index) { SaveRef(ref_index); }
+	} else {
+		SaveClusteredRefs(ref_begin, save_ref_list.size());
+	}
+	save_ref_list.resize(ref_begin);
+}
+
+void BlockManager::SaveClusteredRefs(data_t ref_begin, data_t ref_end) {
+	data_t cluster_end = std::min(ref_end, ref_begin + cluster_size);
+	if (cluster_end > ref_begin) {
+		data_t list_size = save_ref_list.size();
+		std::vector<data_t> bound_list(1, list_size);
+		for (data_t ref_index = ref_begin; ref_index < cluster_end; ++ref_index) { SaveRef(ref_index); bound_list.push_back(save_ref_list.size()); }
+		for (data_t bound = 1; bound < bound_list.size(); ++bound) { SaveClusteredRefs(bound_list[bound - 1], bound_list[bound]); }
+		save_ref_list.resize(list_size);
+	}
+	for (data_t ref_index = cluster_end; ref_index < ref_end; ++ref_index) {
+		data_t child_begin = save_ref_list.size(); SaveRef(ref_index);
+		SaveClusteredRefs(child_begin, save_ref_list.size()); save_ref_list.resize(child_begin);
+	}
+}
+
+bool BlockManager::IsSpillable(data_t cache_index, std::unordered_map<data_t, bool>& spillable_map) {
+	if (auto it = spillable_map.find(cache_index); it != spillable_map.end()) { return it->second; }
+	spillable_map.emplace(cache_index, false);  // blocks on a cycle stay in memory
+	std::vector<BlockSizeContext::RefInfo> ref_list;
+	BlockSizeContext size_context(ref_list);
+	static_cast<const BlockTypeInfo*>(cache->GetNewBlockType(cache_index))->size(size_context, cache->GetNewBlockData(cache_index));
+	cache->SetNewBlockFootprint(cache_index, size_context.GetSize());
+	if (cache->IsNewBlockPinned(cache_index)) { return false; }
+	for (auto& ref : ref_list) {
+		data_t index = *ref.index;
+		if (ref.manager != this || index == block_index_invalid) { return false; }
+		if (is_const_block_index(index)) { continue; }
+		data_t child = convert_new_block_index_to_cache(index);
+		if (child >= cache->GetNewBlockEntryCount()) { return false; }
+		if (!cache->IsNewBlockLive(child)) { if (cache->IsNewBlockSaved(child)) { continue; } return false; }
+		if (!IsSpillable(child, spillable_map)) { return false; }
+	}
+	return spillable_map[cache_index] = true;
+}
+
+void BlockManager::SpillNewBlocks() {
+	if (IsBulkLoading() || IsConcurrentWriting() || allocation_size > 0) { return; }
+	std::unordered_map<data_t, bool> spillable_map;
+	data_t begin = GetFileSize();
+	for (data_t cache_index = 0; cache_index < cache->GetNewBlockEntryCount(); ++cache_index) {
+		if (!cache->IsNewBlockLive(cache_index) || !IsSpillable(cache_index, spillable_map)) { continue; }
+		data_t index = convert_new_block_index_from_cache(cache_index);
+		static_cast<const BlockTypeInfo*>(cache->GetNewBlockType(cache_index))->save(*this, index); SaveRefs(0);
+	}
+	FlushSavedBlocks();
+	if (GetFileSize() > begin && spill_begin == block_index_invalid) { spill_begin = begin; }
+	spill_threshold = std::max(memory_budget, cache->GetNewBlockFootprint() * 2);  // pinned blocks are not rescanned on every allocation
+}
+
+BlockRef<LogicalDirectory>& BlockManager::GetLogicalDirectory() {
+	if (logical_directory.manager == nullptr) {
+		if (meta_info.logical_index != block_index_invalid) {
+			LoadBlockRef(logical_directory, meta_info.logical_index);
+		} else {
+			CheckWritable(); logical_directory = BlockRef<LogicalDirectory>(*this);
+		}
+	}
+	return logical_directory;
+}
+
+void BlockManager::CheckLogicalWritable() const {
+	CheckWritable();
+	if (parent != nullptr) { throw std::runtime_error("concurrent writer cannot write logical blocks"); }
+	if (IsBulkLoading()) { throw std::runtime_error("bulk load in progress"); }
+}
+
+data_t BlockManager::AllocateLogicalId() {
+	return GetLogicalDirectory().Write()->next_id++;
+}
+
+const LogicalPage& BlockManager::GetLogicalPage(data_t index) {
+	auto it = logical_page_cache.find(index);
+	if (it == logical_page_cache.end()) {
+		if (logical_page_cache.size() >= logical_page_cache_size) { logical_page_cache.erase(logical_page_cache.begin()); }
+		it = logical_page_cache.emplace(index, GetBlock<LogicalPage>(index)).first;
+	}
+	return *it->second;
+}
+
+data_t BlockManager::ResolveLogicalId(data_t id) {
+	std::lock_guard<std::mutex> lock(logical_mutex);
+	if (logical_directory.manager == nullptr && meta_info.logical_index == block_index_invalid) { throw std::runtime_error("invalid logical id"); }
+	BlockPtr<const LogicalDirectory> directory = GetLogicalDirectory().Read();
+	if (id >= directory->next_id || (directory->height * logical_page_bits < 64 && id >> (directory->height * logical_page_bits) != 0)) { throw std::runtime_error("invalid logical id"); }
+	data_t index = directory->root_index;
+	for (data_t level = directory->height; level > 0 && index != block_index_invalid; --level) {
+		index = GetLogicalPage(index).entry_list[(id >> ((level - 1) * logical_page_bits)) % logical_page_entry_count];
+	}
+	if (index == block_index_invalid) { throw std::runtime_error("invalid logical id"); }
+	return index;
+}
+
+data_t BlockManager::SaveLogicalPage(data_t index, data_t level, std::vector<std::pair<data_t, data_t>>::const_iterator begin, std::vector<std::pair<data_t, data_t>>::const_iterator end) {
+	LogicalPage page; if (index == block_index_invalid) { page.entry_list.fill(block_index_invalid); } else { page = GetLogicalPage(index); }
+	data_t shift = level * logical_page_bits;
+	while (begin != end) {
+		data_t slot = (begin->first >> shift) % logical_page_entry_count;
+		auto next = std::find_if(begin, end, [&](const std::pair<data_t, data_t>& entry) { return (entry.first >> shift) % logical_page_entry_count != slot; });
+		page.entry_list[slot] = level == 0 ? begin->second : SaveLogicalPage(page.entry_list[slot], level - 1, begin, next);
+		begin = next;
+	}
+	data_t page_index = block_index_invalid; *CreateNewBlock<LogicalPage>(page_index) = page;
+	SaveBlock<LogicalPage>(page_index); return page_index;
+}
+
+void BlockManager::SaveLogicalBlocks() {
+	if (logical_directory.manager == nullptr) { return; }
+	for (auto& [id, info] : logical_new_map) { info.type->save(*this, info.index); SaveRefs(0); }
+	if (!logical_new_map.empty()) {
+		std::vector<std::pair<data_t, data_t>> update_list; update_list.reserve(logical_new_map.size());
+		for (auto& [id, info] : logical_new_map) { update_list.emplace_back(id, info.index); }
+		std::sort(update_list.begin(), update_list.end());
+		BlockPtr<LogicalDirectory> directory = GetLogicalDirectory().Write();
+		while (directory->height == 0 || (directory->height * logical_page_bits < 64 && (directory->next_id - 1) >> (directory->height * logical_page_bits) != 0)) {
+			if (directory->root_index != block_index_invalid) {  // the old root becomes the first child of a new root
+				LogicalPage page; page.entry_list.fill(block_index_invalid); page.entry_list[0] = directory->root_index;
+				data_t page_index = block_index_invalid; *CreateNewBlock<LogicalPage>(page_index) = page;
+				SaveBlock<LogicalPage>(page_index); directory->root_index = page_index;
+			}
+			directory->height++;
+		}
+		std::lock_guard<std::mutex> lock(logical_mutex);
+		directory->root_index = SaveLogicalPage(directory->root_index, directory->height - 1, update_list.begin(), update_list.end());
+	}
+	logical_new_map.clear();
+	SaveBlock<LogicalDirectory>(logical_directory.index); SaveRefs(0);
+	meta_info.logical_index = logical_directory.index;
+}
+
+void BlockManager::ResetLogicalTable() {
+	std::lock_guard<std::mutex> lock(logical_mutex);
+	logical_page_cache.clear(); logical_new_map.clear(); logical_directory = BlockRef<LogicalDirectory>();
+}
+
+void BlockManager::LoadFingerprintIndex() {
+	if (fingerprint_loaded) { return; }
+	for (data_t index = meta_info.fingerprint_index; index != block_index_invalid;) {
+		data_t header[3]; file->Read(index, header, sizeof(header));
+		data_t size = header[0], count = header[2];
+		if (size != sizeof(data_t) * 2 + count * sizeof(FingerprintEntry)) { throw std::runtime_error("invalid fingerprint index"); }
+		std::vector<FingerprintEntry> entry_list(count); file->Read(index + sizeof(header), entry_list.data(), count * sizeof(FingerprintEntry));
+		for (auto& entry : entry_list) { fingerprint_map.emplace(entry.hash, entry); }
+		index = header[1];
+	}
+	fingerprint_loaded = true;
+}
+
+void BlockManager::SaveFingerprintIndex() {
+	if (fingerprint_list.empty()) { return; }
+	data_t size = sizeof(data_t) * 2 + fingerprint_list.size() * sizeof(FingerprintEntry), index;
+	byte* data = AllocateDedupBlock(size, index) + sizeof(data_t);
+	data_t header[2] = { meta_info.fingerprint_index, fingerprint_list.size() }; memcpy(data, header, sizeof(header));
+	memcpy(data + sizeof(header), fingerprint_list.data(), fingerprint_list.size() * sizeof(FingerprintEntry));
+	meta_info.fingerprint_index = index; fingerprint_list.clear();
+}
+
+byte* BlockManager::AllocateDedupBlock(data_t size, data_t& block_index) {
+	block_index = AllocateBlock(size);
+	dedup_buffer.resize(allocation_size / sizeof(data_t));
+	byte* data = dedup_buffer_data(block_index); memcpy(data, &size, sizeof(data_t));
+	return data;
+}
+
+data_t BlockManager::CommitDedupBlock(data_t block_index, data_t size, uint64 type_hash) {
+	const byte* data = dedup_buffer_data(block_index) + sizeof(data_t);
+	uint64 hash = hash_block(data, size) ^ type_hash;  // equal bytes of different types must stay distinct blocks
+	for (auto [it, end] = fingerprint_map.equal_range(hash); it != end; ++it) {
+		if (it->second.type_hash != type_hash) { continue; }
+		data_t index = it->second.index; bool equal;
+		if (index >= GetFileSize()) {
+			equal = memcmp(dedup_buffer_data(index), data - sizeof(data_t), sizeof(data_t) + size) == 0;
+		} else {
+			if (index + sizeof(data_t) + size > GetFileSize()) { continue; }
+			BlockFileLock lock(*file, index, sizeof(data_t) + size);
+			equal = memcmp(lock.GetData(), data - sizeof(data_t), sizeof(data_t) + size) == 0;
+		}
+		if (equal) {
+			allocation_size -= sizeof(data_t) + size; dedup_buffer.resize(allocation_size / sizeof(data_t));
+			return index;
+		}
+	}
+	FingerprintEntry entry = { hash, type_hash, block_index };
+	fingerprint_map.emplace(hash, entry); fingerprint_list.push_back(entry);
+	return block_index;
+}
+
+void BlockManager::FlushDedupBlocks() {
+	SaveFingerprintIndex();
+	data_t begin = file->GetSize(), length = allocation_size;
+	file->SetSize(begin + length); allocation_size = 0;
+	file->Write(begin, dedup_buffer.data(), length);
+	dedup_buffer.clear();
+}
+
+void BlockManager::BeginBulkLoad() {
+	CheckWritable(); CheckRootOwner();
+	if (IsBulkLoading()) { throw std::runtime_error("bulk load in progress"); }
+	if (IsConcurrentWriting()) { throw std::runtime_error("concurrent write in progress"); }
+	if (!save_list.empty() || allocation_size > 0) { throw std::runtime_error("save in progress"); }
+	if (!logical_new_map.empty()) { throw std::runtime_error("logical blocks not saved"); }
+	bulk_begin = bulk_end = file->GetSize();
+}
+
+data_t BlockManager::AllocateBulkBlock(data_t size) {
+	data_t offset = file->AlignExtent(bulk_end, sizeof(data_t) + size); bulk_end = offset + sizeof(data_t) + size;
+	if (bulk_end > file->GetSize()) {
+		data_t reserve_size = file->GetSize() / 4 > bulk_reserve_size ? file->GetSize() / 4 : bulk_reserve_size;
+		file->SetSize(bulk_end + reserve_size);
+	}
+	return offset;
+}
+
+BlockFileLock BlockManager::LockBulkBlock(data_t index, data_t size) {
+	file->Write(index, &size, sizeof(data_t));
+	return BlockFileLock(*file, index + sizeof(data_t), size, true);
+}
+
+void BlockManager::EndBulkLoad(data_t size) {
+	file->SetSize(size); bulk_begin = bulk_end = block_index_invalid;
+}
+
+void BlockManager::BeginConcurrentWrite(data_t reserve_size) {
+	CheckWritable(); CheckRootOwner();
+	if (IsBulkLoading()) { throw std::runtime_error("bulk load in progress"); }
+	if (IsConcurrentWriting()) { throw std::runtime_error("concurrent write in progress"); }
+	if (!save_list.empty() || allocation_size > 0) { throw std::runtime_error("save in progress"); }
+	append_begin = append_end = file->GetSize(); append_limit = append_begin + reserve_size;
+	file->SetSize(append_limit);  // writers never remap the file
+}
+
+data_t BlockManager::ClaimExtent(data_t size) {
+	data_t begin = append_end.fetch_add(size);
+	if (begin + size > append_limit) { throw std::runtime_error("concurrent write reserve exhausted"); }
+	return begin;
+}
+
+data_t BlockManager::AllocateWriterBlock(data_t size) {
+	data_t length = sizeof(data_t) + size, offset;
+	for (data_t claim_size = std::max<data_t>(writer_extent_size, length); (offset = file->AlignExtent(extent_begin, length)) + length > extent_end;) {
+		extent_begin = parent->ClaimExtent(claim_size); extent_end = extent_begin + claim_size;
+		claim_size = std::max<data_t>(writer_extent_size, length + file->GetSegmentSize());  // a claim whose block straddled a segment is retried with room to skip to the boundary
+	}
+	extent_begin = offset + length;
+	return offset;
+}
+
+void BlockManager::EndConcurrentWrite(data_t size) {
+	file->SetSize(std::min<data_t>(size, append_limit)); append_begin = append_limit = block_index_invalid;
+}
+
+void BlockManager::PatchBlock(data_t index, const byte* data, data_t size) {
+	if (!change_log_directory.empty()) { throw std::runtime_error("in-place update is not replicated by the change log"); }
+	if (parent != nullptr) { throw std::runtime_error("concurrent writer cannot update in place"); }
+	if (dedup_enabled || meta_info.fingerprint_index != block_index_invalid) { throw std::runtime_error("in-place update of a deduplicated store"); }
+	data_t length; file->Read(index, &length, sizeof(data_t));
+	if (length != size) { throw std::runtime_error("block size mismatch"); }
+	if (redo_log != nullptr) {
+		RedoRecordHeader header = { index, size, hash_block(data, size) ^ index };
+		data_t end = redo_size + sizeof(RedoRecordHeader) + size;
+		if (end > redo_log->GetSize()) { redo_log->SetSize(std::max<data_t>({ end, (data_t)redo_log->GetSize() * 2, redo_log_reserve_size })); }
+		redo_log->Write(redo_size, &header, sizeof(RedoRecordHeader));
+		redo_log->Write(redo_size + sizeof(RedoRecordHeader), data, size);
+		redo_log->Flush(); redo_size = end;
+	}
+	file->Write(index + sizeof(data_t), data, size);
+}
+
+void BlockManager::ReplayRedoLog() {
+	std::vector<byte> data;
+	for (data_t offset = 0; offset + sizeof(RedoRecordHeader) <= redo_log->GetSize();) {
+		RedoRecordHeader header; redo_log->Read(offset, &header, sizeof(RedoRecordHeader));
+		if (header.length == 0 || header.length % sizeof(data_t) != 0) { break; }
+		if (header.length > redo_log->GetSize() - offset - sizeof(RedoRecordHeader)) { break; }
+		data.resize(header.length); redo_log->Read(offset + sizeof(RedoRecordHeader), data.data(), header.length);
+		if ((hash_block(data.data(), header.length) ^ header.index) != header.hash) { break; }  // torn tail
+		if (header.index >= meta_info_size && header.index + sizeof(data_t) + header.length <= file->GetSize()) {
+			data_t length; file->Read(header.index, &length, sizeof(data_t));
+			if (length == header.length) { file->Write(header.index + sizeof(data_t), data.data(), header.length); }
+		}
+		offset += sizeof(RedoRecordHeader) + header.length;
+	}
+	file->Flush();
+}
+
+void BlockManager::TruncateRedoLog() {
+	if (redo_log == nullptr || redo_log->GetSize() == 0) { return; }
+	redo_log->SetSize(0); redo_size = 0;
+	redo_log->Flush();  // stale records must not outlive the store flush that made them redundant
+}
+
+void BlockManager::SetRedoLog(const std::wstring& path) {
+	CheckWritable();
+	redo_log.reset(); redo_size = 0;
+	if (path.empty()) { return; }
+	redo_log = std::make_unique<FileManager>(path.c_str(), FileManager::CreateMode::OpenAlways);
+	ReplayRedoLog(); TruncateRedoLog();
+}
+
+void BlockManager::Flush() {
+	CheckWritable();
+	file->Flush(); TruncateRedoLog();
+}
+
+void BlockManager::WriteChangeSegment(data_t begin) {
+	if (change_log_directory.empty()) { return; }
+	file->Flush();  // the range is durable in the store before a replica can apply it
+	ChangeSegmentHeader header = { begin, GetFileSize(), meta_info }; header.meta_info.file_size = header.end;
+	std::wstring path = change_segment_path(change_log_directory, begin), temp_path = path + L".tmp";
+	{
+		FileManager segment(temp_path.c_str(), FileManager::CreateMode::CreateAlways);
+		segment.SetSize(sizeof(ChangeSegmentHeader) + (header.end - header.begin));
+		segment.Write(0, &header, sizeof(ChangeSegmentHeader));
+		if (header.end > header.begin) {
+			BlockFileLock data(segment, sizeof(ChangeSegmentHeader), header.end - header.begin, true);
+			file->Read(header.begin, data.GetData(), header.end - header.begin);
+		}
+		segment.Flush();  // renamed only once complete, the meta info is published after it
+	}
+	std::filesystem::rename(temp_path, path);
+}
+
+bool BlockManager::ApplyChangeSegment(const std::wstring& path) {
+	FileManager segment(path.c_str(), FileManager::CreateMode::OpenExisting, FileManager::AccessMode::ReadOnly, FileManager::ShareMode::ReadOnly);
+	if (segment.GetSize() < sizeof(ChangeSegmentHeader)) { throw std::runtime_error("invalid change segment"); }
+	ChangeSegmentHeader header; segment.Read(0, &header, sizeof(ChangeSegmentHeader));
+	if (header.begin != GetFileSize() || header.end < header.begin || header.meta_info.file_size != header.end ||
+		segment.GetSize() != sizeof(ChangeSegmentHeader) + (header.end - header.begin)) {
+		throw std::runtime_error("invalid change segment");
+	}
+	if (header.end > header.begin) {
+		file->SetSize(header.end);
+		BlockFileLock data(segment, sizeof(ChangeSegmentHeader), header.end - header.begin);
+		file->Write(header.begin, data.GetData(), header.end - header.begin);
+	}
+	meta_info = header.meta_info;
+	SaveMetaInfo();
+	return header.end > header.begin;
+}
+
+void BlockManager::RecoverChangeSegment() {
+	if (GetFileSize() < meta_info_size || meta_info.file_size < meta_info_size) { return; }
+	if (IsBulkLoading() || IsConcurrentWriting() || !save_list.empty() || allocation_size > 0 || spill_begin != block_index_invalid) { return; }
+	if (std::wstring path = change_segment_path(change_log_directory, meta_info.file_size); std::filesystem::exists(path)) {
+		FileManager segment(path.c_str(), FileManager::CreateMode::OpenExisting, FileManager::AccessMode::ReadOnly, FileManager::ShareMode::ReadOnly);
+		ChangeSegmentHeader header = {}; if (segment.GetSize() >= sizeof(ChangeSegmentHeader)) { segment.Read(0, &header, sizeof(ChangeSegmentHeader)); }
+		bool written = header.begin == meta_info.file_size && header.end > header.begin && header.end <= GetFileSize() &&
+			header.meta_info.file_size == header.end && segment.GetSize() == sizeof(ChangeSegmentHeader) + (header.end - header.begin);
+		if (written) {  // a stale segment from before a format does not match the store
+			BlockFileLock data(segment, sizeof(ChangeSegmentHeader), header.end - header.begin);
+			file->ForEachExtent(header.begin, header.end - header.begin, [&](uint64 offset, uint64 extent) {
+				BlockFileLock lock(*file, offset, extent); written = written && memcmp(lock.GetData(), data.GetData() + (offset - header.begin), extent) == 0;
+			});
+		}
+		if (written) {  // the commit crashed after replicas could see it, so it is published here too
+			file->SetSize(header.end);
+			meta_info = header.meta_info;
+			SaveMetaInfo();
+			ResetCommittedState();
+		}
+	}
+	if (GetFileSize() > meta_info.file_size) { file->SetSize(meta_info.file_size); }  // the next segment begins where replicas stopped
+}
+
+void BlockManager::ResetCommittedState() {
+	ResetLogicalTable();
+	if (fingerprint_loaded) {
+		fingerprint_map.clear(); fingerprint_loaded = false;
+		if (dedup_enabled) { LoadFingerprintIndex(); }
+	}
+}
+
+void BlockManager::SetChangeLog(std::wstring directory) {
+	if (parent != nullptr) { throw std::runtime_error("concurrent writer cannot keep a change log"); }  // the parent logs writer extents at commit
+	change_log_directory = std::move(directory);
+	if (!change_log_directory.empty() && !read_only) { RecoverChangeSegment(); }
+}
+
+data_t BlockManager::ApplyChangeLog(const std::wstring& directory) {
+	CheckWritable();
+	if (IsBulkLoading()) { throw std::runtime_error("bulk load in progress"); }
+	if (IsConcurrentWriting()) { throw std::runtime_error("concurrent write in progress"); }
+	if (!save_list.empty() || allocation_size > 0) { throw std::runtime_error("save in progress"); }
+	if (GetFileSize() < meta_info_size) { throw std::runtime_error("block manager not formatted"); }
+	data_t segment_count = 0;
+	for (std::wstring path; std::filesystem::exists(path = change_segment_path(directory, GetFileSize())); ) {
+		++segment_count; if (!ApplyChangeSegment(path)) { break; }
+	}
+	if (segment_count > 0) { ResetCommittedState(); }
+	return segment_count;
+}
+
+void BlockManager::ScanBlocks(data_t index, const BlockTypeInfo& type, block_visitor visitor, error_handler handler, BlockFile::AccessPattern pattern) {
+	if (index == block_index_invalid) { return; }
+	BlockScanContext context(GetThreadPool(), file->GetSize());
+	if (pattern != BlockFile::AccessPattern::Normal) { file->Advise(meta_info_size, file->GetSize() - meta_info_size, pattern); }
+	context.visitor = std::move(visitor);
+	context.handler = handler != nullptr ? std::move(handler) : [](data_t index, const char* message) { throw std::runtime_error(message); };
+	std::exception_ptr exception;
+	try {
+		ScanLogicalTable(context);
+		ScanRef(context, index, type);
+	} catch (...) {
+		exception = std::current_exception();
+	}
+	try {
+		context.thread_pool.Wait(context.group);  // queued tasks reference the context, so they are drained before any rethrow
+	} catch (...) {
+		if (exception == nullptr) { exception = std::current_exception(); }
+	}
+	if (exception != nullptr) { std::rethrow_exception(exception); }
+}
+
+void BlockManager::ScanRef(BlockScanContext& context, data_t index, const BlockTypeInfo& type) {
+	if (!is_const_block_index(index) || index < meta_info_size || index >= file->GetSize()) {
+		context.Report(index, "invalid block index"); return;
+	}
+	data_t bit = index / sizeof(data_t); uint64 mask = (uint64)1 << (bit % 64);
+	if (context.visited_map[bit / 64].fetch_or(mask) & mask) { return; }
+	context.thread_pool.Submit(context.group, [this, &context, index, &type]() {
+		if (context.stopped) { return; }
+		try {
+			type.scan(*this, context, index);
+		} catch (std::exception& e) {
+			if (context.stopped) { throw; }  // already reported
+			context.Report(index, e.what());
+		}
+	});
+}
+
+void BlockManager::ScanLogicalTable(BlockScanContext& context) {
+	if (meta_info.logical_index == block_index_invalid) { return; }
+	ScanRef(context, meta_info.logical_index, block_type_info<LogicalDirectory>);
+	try {
+		BlockPtr<const LogicalDirectory> directory = GetBlock<LogicalDirectory>(meta_info.logical_index);
+		ScanLogicalPage(context, directory->root_index, directory->height);
+	} catch (std::exception& e) {
+		if (context.stopped) { throw; }
+		context.Report(meta_info.logical_index, e.what());
+	}
+}
+
+void BlockManager::ScanLogicalPage(BlockScanContext& context, data_t index, data_t height) {
+	if (index == block_index_invalid || height == 0) { return; }
+	ScanRef(context, index, block_type_info<LogicalPage>);
+	if (height == 1) { return; }
+	BlockPtr<const LogicalPage> page = GetBlock<LogicalPage>(index);
+	for (data_t entry : page->entry_list) { ScanLogicalPage(context, entry, height - 1); }
+}
+
+void BlockManager::ScanLogicalRef(BlockScanContext& context, data_t index, data_t id, const BlockTypeInfo& type) {
+	data_t target;
+	try {
+		target = ResolveLogicalId(id);
+	} catch (std::exception& e) {
+		context.Report(index, e.what()); return;
+	}
+	ScanRef(context, target, type);
 }
 
-void BlockManager::RenewSaveContext(BlockSaveContext& context) {
-	data_t length_saved = context.curr - context.begin, length_remaining = context.end - context.curr;
-	context.curr = file->Lock(context.index + sizeof(data_t) + length_saved, length_remaining);
-	context.begin = context.curr - length_saved; context.end = context.curr + length_remaining;
+void BlockManager::VisitBlock(BlockScanContext& context, data_t index, data_t size) {
+	data_t length; file->Read(index, &length, sizeof(data_t));
+	if (length != size) { throw std::runtime_error("block size mismatch"); }
+	if (context.visitor != nullptr) { context.visitor(index, length); }
 }
 
 END_NAMESPACE(BlockStore)
\ No newline at end of file
@@ -3,23 +3,70 @@
 #include "meta_info.h"
 #include "block_traits.h"
 #include "block_ref.h"
+#include "block_pool.h"
+#include "block_file.h"
+#include "stl_helper.h"
 
 #include <memory>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <typeinfo>
 
 
 BEGIN_NAMESPACE(BlockStore)
 
-class FileManager;
 class BlockCache;
+class FileManager;
+class ThreadPool;
+class TaskGroup;
+
+
+struct BlockCheckResult {
+	data_t block_count = 0;
+	data_t reachable_size = 0;
+	data_t total_size = 0;
+	std::vector<std::pair<data_t, std::string>> error_list;
+};
+
+
+enum class PlacementPolicy { DepthFirst, BreadthFirst, Clustered };
+
+
+constexpr uint logical_page_bits = 6;
+constexpr data_t logical_page_entry_count = (data_t)1 << logical_page_bits;
+
+struct LogicalPage {
+	std::array<data_t, logical_page_entry_count> entry_list;  // block indices at the bottom level, page indices above
+};
+
+struct LogicalDirectory {
+	data_t next_id = 0;
+	data_t height = 0;  // levels of pages, the root page covers ids below 1 << (logical_page_bits * height)
+	data_t root_index = block_index_invalid;
+};
+
+constexpr auto layout(layout_type<LogicalDirectory>) { return declare(&LogicalDirectory::next_id, &LogicalDirectory::height, &LogicalDirectory::root_index); }
 
 
 class BlockManager {
 public:
-	BlockManager(std::unique_ptr<FileManager> file);
+	BlockManager(std::unique_ptr<BlockFile> file);
+	BlockManager(BlockManager& parent);
 	~BlockManager();
 
 private:
-	std::unique_ptr<FileManager> file;
+	std::unique_ptr<BlockFile> file;
+	const bool read_only;
+private:
+	data_t GetFileSize() const;
+	void CheckWritable() const { if (read_only) { throw std::runtime_error("block manager is read only"); } }
+public:
+	bool IsReadOnly() const { return read_only; }
 
 	// meta
 private:
@@ -29,6 +76,7 @@ private:
 	void SaveMetaInfo();
 public:
 	void Format();
+	bool Refresh();
 
 	// cache
 private:
@@ -36,69 +84,85 @@ private:
 private:
 	static bool is_const_block_index(data_t index) { return index % sizeof(data_t) == 0; }
 private:
-	bool IsBlockCached(data_t index);
-	void SetCachedBlock(data_t index, std::weak_ptr<void> weak_ptr);
-	std::shared_ptr<void> GetCachedBlock(data_t index);
-	void CheckCachedBlock(data_t index);
+	using block_loader = ref_ptr<BlockNode>(*)(BlockManager& manager, data_t index);
+	ref_ptr<BlockNode> GetCachedBlock(data_t index);
+	ref_ptr<BlockNode> GetCachedBlock(data_t index, block_loader loader);
+	void ReleaseCachedBlock(data_t index, ref_ptr<BlockNode> node);
+	void EvictCachedBlock(data_t index);
+	void ReleaseNode(ref_ptr<BlockNode> node) {
+		data_t index = node->index; if (node->Release()) { ReleaseCachedBlock(index, node); }
+	}
+	template<class T>
+	BlockPtr<const T> GetCachedBlockPtr(ref_ptr<BlockNode> node) {
+		if (node->type != &block_type_info<T>) { ReleaseNode(node); throw std::runtime_error("pointer type mismatch"); }
+		return BlockPtr<const T>(*this, *node);
+	}
+private:
+	static uint64 HashTypeName(const char* name);
+	template<class T>
+	static uint64 block_type_hash() { static const uint64 hash = HashTypeName(typeid(T).name()); return hash; }  // stable across runs, unlike &block_type_info<T>
 private:
 	static bool is_new_block_index(data_t index) { return (index & 1) != 0; }
 	static data_t convert_new_block_index_from_cache(data_t index) { return index * 2 + 1; }
 	static data_t convert_new_block_index_to_cache(data_t index) { return index / 2; }
 private:
-	data_t AddNewBlock(std::shared_ptr<void> ptr);
-	std::shared_ptr<void> GetNewBlock(data_t index);
+	data_t AddNewBlock(std::shared_ptr<void> ptr, const void* type);
+	std::shared_ptr<void> GetNewBlock(data_t index, const void* type);
 	void IncRefNewBlock(data_t index);
 	void DecRefNewBlock(data_t index);
 	bool IsNewBlockSaved(data_t index);
 	void SaveNewBlock(data_t index, data_t block_index);
 	data_t GetSavedBlockIndex(data_t index);
+	void ChargeNewBlock(data_t index);
+	data_t GetNewBlockFootprint();
 	void ClearNewBlock();
 
 	// resource
 private:
-	template<class T>
-	struct deleter {
-		void operator()(T* object) { delete object; }
-	};
-	template<class T>
-	static std::shared_ptr<T> pointer_cast(const std::shared_ptr<void>& ptr) {
-		if (std::get_deleter<deleter<T>>(ptr) == nullptr) { throw std::runtime_error("pointer type mismatch"); }
-		return std::static_pointer_cast<T>(ptr);
-	}
-	template<class T>
-	static std::shared_ptr<T> pointer_cast(std::shared_ptr<void>&& ptr) {
-		if (std::get_deleter<deleter<T>>(ptr) == nullptr) { throw std::runtime_error("pointer type mismatch"); }
-		return std::static_pointer_cast<T>(std::move(ptr));
+	BlockPool& GetBlockPool();
+	template<class T, class... Args>
+	std::shared_ptr<T> MakeNewBlock(Args&&... args) {
+		return std::allocate_shared<T>(BlockAllocator<T>(GetBlockPool()), std::forward<Args>(args)...);
 	}
 
 	// load
 private:
-	BlockLoadContext LoadBlockContext(data_t index);
+	BlockFileLock LockBlock(data_t index);
 private:
 	template<class T>
-	std::shared_ptr<T> LoadBlock(data_t index) {
-		std::shared_ptr<T> block(new T(), deleter<T>());
-		BlockLoadContext context = LoadBlockContext(index); Load(context, *block);
-		return block;
+	void LoadBlock(data_t index, T& block, ref_ptr<std::optional<std::pmr::monotonic_buffer_resource>> arena = nullptr) {
+		BlockFileLock lock = LockBlock(index);
+		BlockLoadContext context(*this, lock.GetData(), lock.GetLength(), arena); Load(context, block);
 	}
 	template<class T>
-	std::shared_ptr<T> GetCachedBlock(data_t index) {
-		return pointer_cast<T>(GetCachedBlock(index));
+	static ref_ptr<BlockNode> LoadCachedBlock(BlockManager& manager, data_t index) {
+		std::unique_ptr<BlockObject<T>> node(new BlockObject<T>(index, &block_type_info<T>));
+		manager.LoadBlock(index, node->object, &node->arena); return node.release();
 	}
 	template<class T>
-	std::shared_ptr<T> GetBlock(data_t index) {
-		if (IsBlockCached(index)) {
-			return GetCachedBlock<T>(index);
-		} else {
-			std::shared_ptr<T> block = LoadBlock<T>(index);
-			SetCachedBlock(index, block);
-			return block;
-		}
+	BlockPtr<const T> GetBlock(data_t index) {
+		if (hot_set_capacity > 0) { RecordHotBlock(index, block_type_hash<T>()); }
+		ref_ptr<BlockNode> node = GetCachedBlock(index, LoadCachedBlock<T>);
+		if (node->type != &block_type_info<T> && DropWarmBlock(node)) { node = GetCachedBlock(index, LoadCachedBlock<T>); }  // warmed as another type
+		return GetCachedBlockPtr<T>(node);
 	}
 private:
 	template<class T>
 	BlockPtr<const T> ReadBlock(data_t& index) {
-		return BlockPtr<const T>(IsNewBlock(index) ? GetNewBlock<T>(index) : GetBlock<T>(index), *this, index);
+		return IsNewBlock(index) ? BlockPtr<const T>(GetNewBlock<T>(index)) : GetBlock<T>(index);
+	}
+	template<class T>
+	BlockPtr<const T> ReadCachedBlock(data_t& index) {
+		if (IsNewBlock(index)) { return BlockPtr<const T>(GetNewBlock<T>(index)); }
+		if (ref_ptr<BlockNode> node = GetCachedBlock(index); node != nullptr) { return GetCachedBlockPtr<T>(node); }
+		return BlockPtr<const T>();
+	}
+	template<class T, class K>
+	auto FindBlock(data_t& index, const K& key) {
+		if (IsNewBlock(index)) { return layout_traits<T>::Find(*GetNewBlock<T>(index), key); }
+		if (ref_ptr<BlockNode> node = GetCachedBlock(index); node != nullptr) { return layout_traits<T>::Find(*GetCachedBlockPtr<T>(node), key); }
+		BlockFileLock lock = LockBlock(index);
+		BlockLoadContext context(*this, lock.GetData(), lock.GetLength()); return layout_traits<T>::Find(context, key);
 	}
 private:
 	template<class T>
@@ -112,6 +176,53 @@ public:
 		LoadBlockRef(root, meta_info.root_index);
 	}
 
+	// async
+private:
+	std::unique_ptr<ThreadPool> io_pool;
+	std::unique_ptr<TaskGroup> io_group;
+	std::mutex io_mutex;
+	uint io_thread_count = 0;
+private:
+	void SubmitRead(std::function<void()> task);
+	void WaitRead();
+public:
+	void SetIOThreadCount(uint thread_count);
+
+	// hot set
+private:
+	struct HotBlockInfo {
+		uint64 type_hash;
+		uint64 count;
+	};
+	struct HotCounter {
+		std::atomic<uint64> type_hash = 0;
+		std::atomic<uint64> count = 0;
+	};
+	struct alignas(64) HotShard {
+		std::shared_mutex mutex;  // shared to count a known block, exclusive to insert or age
+		std::unordered_map<data_t, HotCounter> hot_map;
+	};
+	static constexpr data_t hot_shard_count = 16;
+	std::wstring hot_set_path;
+	std::atomic<data_t> hot_set_capacity = 0;
+	std::array<HotShard, hot_shard_count> hot_shard_list;
+	std::vector<ref_ptr<BlockNode>> warm_list;
+	std::mutex warm_mutex;
+private:
+	static void SelectHotList(std::vector<std::pair<data_t, HotBlockInfo>>& hot_list, data_t capacity);
+	std::vector<std::pair<data_t, HotBlockInfo>> GetHotList();
+	void RecordHotBlock(data_t index, uint64 type_hash);
+	uint64 HashCommittedBlock(data_t index);
+	void WarmBlocks(std::unordered_map<uint64, block_loader> loader_map, bool wait);
+	bool DropWarmBlock(ref_ptr<BlockNode> node);
+public:
+	void SetHotSet(std::wstring path, data_t capacity) { hot_set_path = std::move(path); hot_set_capacity = capacity; }
+	void SaveHotSet();
+	template<class... Ts>
+	void WarmHotSet(bool wait = false) { WarmBlocks({ { block_type_hash<Ts>(), LoadCachedBlock<Ts> }... }, wait); }
+	void ReleaseWarmSet();
+	data_t GetWarmSize() { std::lock_guard<std::mutex> lock(warm_mutex); return warm_list.size(); }
+
 	// create
 private:
 	bool IsNewBlock(data_t& index) {
@@ -127,67 +238,383 @@ private:
 private:
 	template<class T>
 	std::shared_ptr<T> CreateNewBlock(data_t& index) {
+		CheckWritable();
 		std::shared_ptr<T> block_ptr;
 		if (is_const_block_index(index)) {
-			if (IsBlockCached(index)) {
-				block_ptr.reset(new T(*GetCachedBlock<T>(index)), deleter<T>());
+			if (ref_ptr<BlockNode> node = GetCachedBlock(index); node != nullptr) {
+				block_ptr = MakeNewBlock<T>(*GetCachedBlockPtr<T>(node));
 			} else {
-				block_ptr = LoadBlock<T>(index);
+				block_ptr = MakeNewBlock<T>(); LoadBlock(index, *block_ptr);
 			}
 		} else {
-			block_ptr.reset(new T(), deleter<T>());
+			block_ptr = MakeNewBlock<T>();
 		}
-		index = AddNewBlock(block_ptr);
+		index = AddNewBlock(block_ptr, &block_type_info<T>); ChargeNewBlock(index);
+		if (GetNewBlockFootprint() > spill_threshold) { SpillNewBlocks(); }
 		return block_ptr;
 	}
 	template<class T>
 	std::shared_ptr<T> GetNewBlock(data_t index) {
-		return pointer_cast<T>(GetNewBlock(index));
+		return std::static_pointer_cast<T>(GetNewBlock(index, &block_type_info<T>));
 	}
 private:
 	template<class T>
 	BlockPtr<T> WriteBlock(data_t& index) {
-		return IsNewBlock(index) ? GetNewBlock<T>(index) : CreateNewBlock<T>(index);
+		if (!IsNewBlock(index)) { return CreateNewBlock<T>(index); }
+		std::shared_ptr<T> block_ptr = GetNewBlock<T>(index); ChargeNewBlock(index); return block_ptr;  // the estimate trails the edits of the current writer
 	}
 
 	// save
+private:
+	struct BlockSaveInfo {
+		std::shared_ptr<void> block;
+		data_t index;
+		data_t size;
+		ref_ptr<const BlockTypeInfo> type;
+	};
+	std::vector<BlockSaveInfo> save_list;
+	std::vector<BlockSizeContext::RefInfo> save_ref_list;
+	data_t allocation_size = 0;
+	PlacementPolicy placement_policy = PlacementPolicy::DepthFirst;
+	data_t cluster_size = 0;
+private:
+	template<class T>
+	static const BlockTypeInfo block_type_info;
+private:
+	std::unique_ptr<ThreadPool> thread_pool;
+private:
+	ThreadPool& GetThreadPool();
 private:
 	data_t AllocateBlock(data_t size);
-	BlockSaveContext SaveBlockContext(data_t index, data_t size);
-	void RenewSaveContext(BlockSaveContext& context);
+	void FlushSavedBlocks();
+	void SaveRef(data_t ref_index);
+	void SaveRefs(data_t ref_begin);
+	void SaveClusteredRefs(data_t ref_begin, data_t ref_end);
 private:
 	template<class T>
 	void SaveBlock(data_t& index) {
 		if (!IsNewBlock(index)) { return; }
+		if (dedup_enabled) { return SaveDedupBlock<T>(index); }
 		std::shared_ptr<T> block = GetNewBlock<T>(index);
-		BlockSizeContext size_context; Size(size_context, *block);
+		BlockSizeContext size_context(save_ref_list); Size(size_context, *block);
 		data_t block_size = size_context.GetSize(); align_offset<data_t>(block_size);
 		data_t block_index = AllocateBlock(block_size);
 		SaveNewBlock(index, block_index);
 		index = block_index;
-		BlockSaveContext context = SaveBlockContext(block_index, block_size);
-		Save(context, *block);
+		save_list.push_back({ std::move(block), block_index, block_size, &block_type_info<T> });
 	}
 public:
+	void SetPlacementPolicy(PlacementPolicy policy, data_t cluster_size = 4) {
+		placement_policy = policy; this->cluster_size = policy == PlacementPolicy::Clustered ? cluster_size : 0;
+	}
 	template<class T>
 	void SaveRootRef(BlockRef<T>& root) {
 		if (root.manager != this) { throw std::invalid_argument("block manager mismatch"); }
-		SaveBlock<T>(root.index);
+		if (IsBulkLoading()) { throw std::runtime_error("bulk load in progress"); }
+		if (IsConcurrentWriting()) { throw std::runtime_error("concurrent write in progress"); }
+		CheckWritable(); CheckRootOwner();
+		data_t begin = spill_begin != block_index_invalid ? spill_begin : GetFileSize();
+		SaveBlock<T>(root.index); SaveRefs(0);
+		SaveLogicalBlocks();
+		FlushSavedBlocks();
 		meta_info.root_index = root.index;
+		WriteChangeSegment(begin);
+		SaveMetaInfo();
+		ClearNewBlock();
+	}
+
+	// spill
+private:
+	data_t memory_budget = block_index_invalid;
+	data_t spill_threshold = block_index_invalid;
+	data_t spill_begin = block_index_invalid;
+private:
+	bool IsSpillable(data_t cache_index, std::unordered_map<data_t, bool>& spillable_map);
+	void SpillNewBlocks();
+public:
+	void SetMemoryBudget(data_t size) { memory_budget = spill_threshold = size == 0 ? block_index_invalid : size; }
+	data_t GetSpilledSize() const { return spill_begin == block_index_invalid ? 0 : GetFileSize() - spill_begin; }
+
+	// logical
+private:
+	struct LogicalBlockInfo {
+		data_t index;
+		ref_ptr<const BlockTypeInfo> type;
+	};
+	BlockRef<LogicalDirectory> logical_directory;
+	std::unordered_map<data_t, LogicalBlockInfo> logical_new_map;
+	std::unordered_map<data_t, BlockPtr<const LogicalPage>> logical_page_cache;  // keyed by page index, pages are never modified in place
+	std::mutex logical_mutex;
+private:
+	BlockRef<LogicalDirectory>& GetLogicalDirectory();
+	void CheckLogicalWritable() const;
+	data_t AllocateLogicalId();
+	const LogicalPage& GetLogicalPage(data_t index);
+	data_t ResolveLogicalId(data_t id);
+	data_t SaveLogicalPage(data_t index, data_t level, std::vector<std::pair<data_t, data_t>>::const_iterator begin, std::vector<std::pair<data_t, data_t>>::const_iterator end);
+	void SaveLogicalBlocks();
+	void ResetLogicalTable();
+	void ScanLogicalTable(BlockScanContext& context);
+	void ScanLogicalPage(BlockScanContext& context, data_t index, data_t height);
+	void ScanLogicalRef(BlockScanContext& context, data_t index, data_t id, const BlockTypeInfo& type);
+private:
+	template<class T>
+	data_t CreateLogicalBlock() {
+		CheckLogicalWritable();
+		data_t index = block_index_invalid; CreateNewBlock<T>(index);
+		data_t id = AllocateLogicalId();
+		logical_new_map.emplace(id, LogicalBlockInfo{ index, &block_type_info<T> });
+		return id;
+	}
+	template<class T>
+	BlockPtr<const T> ReadLogicalBlock(data_t id) {
+		if (auto it = logical_new_map.find(id); it != logical_new_map.end()) { return ReadBlock<T>(it->second.index); }
+		return GetBlock<T>(ResolveLogicalId(id));
+	}
+	template<class T>
+	BlockPtr<T> WriteLogicalBlock(data_t id) {
+		CheckLogicalWritable();
+		auto it = logical_new_map.find(id);
+		if (it == logical_new_map.end()) { it = logical_new_map.emplace(id, LogicalBlockInfo{ ResolveLogicalId(id), &block_type_info<T> }).first; }
+		return WriteBlock<T>(it->second.index);
+	}
+
+	// dedup
+private:
+	struct DedupPendingInfo {
+		data_t size;
+		data_t index;
+	};
+	struct FingerprintEntry {
+		uint64 hash;
+		uint64 type_hash;
+		data_t index;
+	};
+	bool dedup_enabled = false;
+	bool fingerprint_loaded = false;
+	std::unordered_multimap<uint64, FingerprintEntry> fingerprint_map;
+	std::vector<FingerprintEntry> fingerprint_list;
+	std::unordered_map<data_t, DedupPendingInfo> dedup_pending_map;
+	std::vector<data_t> dedup_buffer;
+private:
+	void LoadFingerprintIndex();
+	void SaveFingerprintIndex();
+	byte* AllocateDedupBlock(data_t size, data_t& block_index);
+	data_t CommitDedupBlock(data_t block_index, data_t size, uint64 type_hash);
+	void FlushDedupBlocks();
+private:
+	template<class T>
+	void SaveDedupBlock(data_t& index) {
+		if (auto it = dedup_pending_map.find(index); it != dedup_pending_map.end()) {
+			DedupPendingInfo& info = it->second;
+			if (info.index == block_index_invalid) { AllocateDedupBlock(info.size, info.index); }
+			index = info.index; return;
+		}
+		std::shared_ptr<T> block = GetNewBlock<T>(index);
+		data_t ref_begin = save_ref_list.size();
+		BlockSizeContext size_context(save_ref_list); Size(size_context, *block);
+		data_t ref_end = save_ref_list.size();
+		data_t block_size = size_context.GetSize(); align_offset<data_t>(block_size);
+		dedup_pending_map.emplace(index, DedupPendingInfo{ block_size, block_index_invalid });
+		for (data_t ref_index = ref_begin; ref_index < ref_end; ++ref_index) {
+			BlockSizeContext::RefInfo ref = save_ref_list[ref_index];
+			if (ref.manager != this) { throw std::invalid_argument("block manager mismatch"); }
+			ref.type->save(*this, *ref.index);
+		}
+		save_ref_list.resize(ref_begin);
+		data_t block_index = dedup_pending_map[index].index; dedup_pending_map.erase(index);
+		bool cyclic = block_index != block_index_invalid;
+		byte* data = cyclic ? dedup_buffer_data(block_index) : AllocateDedupBlock(block_size, block_index);
+		BlockSaveContext context(*this, data + sizeof(data_t), block_size); Save(context, *block);
+		if (!cyclic) { block_index = CommitDedupBlock(block_index, block_size, block_type_hash<T>()); }
+		SaveNewBlock(index, block_index);
+		index = block_index;
+	}
+	byte* dedup_buffer_data(data_t block_index) { return (byte*)dedup_buffer.data() + (block_index - GetFileSize()); }
+public:
+	void EnableDedup(bool enabled) {
+		if (enabled && parent != nullptr) { throw std::runtime_error("concurrent writer cannot deduplicate"); }
+		if (enabled) { LoadFingerprintIndex(); } dedup_enabled = enabled;
+	}
+
+	// bulk load
+private:
+	data_t bulk_begin = block_index_invalid;
+	data_t bulk_end = block_index_invalid;
+private:
+	bool IsBulkLoading() const { return bulk_end != block_index_invalid; }
+	data_t AllocateBulkBlock(data_t size);
+	BlockFileLock LockBulkBlock(data_t index, data_t size);
+	void EndBulkLoad(data_t size);
+public:
+	void BeginBulkLoad();
+	template<class T>
+	BlockRef<T> AppendBlock(const T& block) {
+		if (!IsBulkLoading()) { throw std::runtime_error("bulk load not started"); }
+		BlockSizeContext size_context; Size(size_context, block);
+		data_t block_size = size_context.GetSize(); align_offset<data_t>(block_size);
+		data_t block_index = AllocateBulkBlock(block_size);
+		BlockFileLock lock = LockBulkBlock(block_index, block_size);
+		BlockSaveContext context(*this, lock.GetData(), block_size); Save(context, block);
+		BlockRef<T> block_ref; LoadBlockRef(block_ref, block_index);
+		return block_ref;
+	}
+	template<class T>
+	void CommitBulkLoad(const BlockRef<T>& root) {
+		if (!IsBulkLoading()) { throw std::runtime_error("bulk load not started"); }
+		data_t root_index = GetCommittedIndex(root);
+		data_t begin = bulk_begin;
+		EndBulkLoad(bulk_end);
+		meta_info.root_index = root_index;
+		WriteChangeSegment(begin);
 		SaveMetaInfo();
+	}
+	void AbortBulkLoad() { if (IsBulkLoading()) { EndBulkLoad(bulk_begin); } }
+
+	// concurrent write
+private:
+	ref_ptr<BlockManager> parent = nullptr;
+	std::atomic<data_t> append_end = block_index_invalid;
+	data_t append_begin = block_index_invalid;
+	data_t append_limit = block_index_invalid;
+	data_t extent_begin = 0;
+	data_t extent_end = 0;
+private:
+	void CheckRootOwner() const { if (parent != nullptr) { throw std::runtime_error("concurrent writer cannot commit the root"); } }
+	bool IsConcurrentWriting() const { return append_limit != block_index_invalid; }
+	data_t ClaimExtent(data_t size);
+	data_t AllocateWriterBlock(data_t size);
+	void EndConcurrentWrite(data_t size);
+public:
+	void BeginConcurrentWrite(data_t reserve_size);
+	template<class T>
+	BlockRef<T> SaveSubRootRef(BlockRef<T>& root) {
+		if (root.manager != this) { throw std::invalid_argument("block manager mismatch"); }
+		if (parent == nullptr) { throw std::runtime_error("block manager is not a concurrent writer"); }
+		SaveBlock<T>(root.index); SaveRefs(0);
+		FlushSavedBlocks();
+		data_t root_index = root.index;
 		ClearNewBlock();
+		BlockRef<T> sub_root; parent->LoadBlockRef(sub_root, root_index);
+		return sub_root;
+	}
+	template<class T>
+	void CommitConcurrentWrite(BlockRef<T>& root) {
+		if (!IsConcurrentWriting()) { throw std::runtime_error("concurrent write not started"); }
+		data_t begin = append_begin;
+		EndConcurrentWrite(append_end);
+		if (spill_begin == block_index_invalid) { spill_begin = begin; }
+		SaveRootRef(root);
+	}
+	void AbortConcurrentWrite() { if (IsConcurrentWriting()) { EndConcurrentWrite(append_begin); } }
+
+	// update
+private:
+	std::unique_ptr<FileManager> redo_log;
+	data_t redo_size = 0;
+private:
+	void PatchBlock(data_t index, const byte* data, data_t size);
+	void ReplayRedoLog();
+	void TruncateRedoLog();
+private:
+	template<class T>
+	void UpdateBlock(data_t& index, const T& block) {
+		static_assert(has_fixed_layout<T>, "in-place update requires a fixed size layout");
+		CheckWritable();
+		if (IsNewBlock(index)) { *GetNewBlock<T>(index) = block; return; }
+		BlockSizeContext size_context; Size(size_context, block);
+		data_t block_size = size_context.GetSize(); align_offset<data_t>(block_size);
+		std::vector<data_t> buffer(block_size / sizeof(data_t));
+		BlockSaveContext context(*this, (byte*)buffer.data(), block_size); Save(context, block);
+		PatchBlock(index, (const byte*)buffer.data(), block_size);
+		EvictCachedBlock(index);  // readers holding the old node keep their copy
+	}
+public:
+	void SetRedoLog(const std::wstring& path);
+	void Flush();
+
+	// change log
+private:
+	std::wstring change_log_directory;
+private:
+	void WriteChangeSegment(data_t begin);
+	bool ApplyChangeSegment(const std::wstring& path);
+	void RecoverChangeSegment();
+	void ResetCommittedState();
+public:
+	void SetChangeLog(std::wstring directory);
+	data_t ApplyChangeLog(const std::wstring& directory);
+
+	// scan
+private:
+	using block_visitor = std::function<void(data_t index, data_t length)>;
+	using error_handler = std::function<void(data_t index, const char* message)>;
+private:
+	template<class T>
+	data_t GetCommittedIndex(const BlockRef<T>& root) {
+		if (root.manager != this) { throw std::invalid_argument("block manager mismatch"); }
+		data_t index = root.index; if (IsNewBlock(index)) { throw std::invalid_argument("block ref not committed"); }
+		return index;
+	}
+	void ScanBlocks(data_t index, const BlockTypeInfo& type, block_visitor visitor, error_handler handler, BlockFile::AccessPattern pattern);
+	void ScanRef(BlockScanContext& context, data_t index, const BlockTypeInfo& type);
+	void VisitBlock(BlockScanContext& context, data_t index, data_t size);
+	template<class T>
+	void ScanBlock(BlockScanContext& context, data_t index) {
+		BlockPtr<const T> cached_block; std::unique_ptr<T> loaded_block; const T* block;
+		if (ref_ptr<BlockNode> node = GetCachedBlock(index); node != nullptr) {
+			cached_block = GetCachedBlockPtr<T>(node); block = cached_block.get();
+		} else {
+			loaded_block.reset(new T()); LoadBlock(index, *loaded_block); block = loaded_block.get();
+		}
+		std::vector<BlockSizeContext::RefInfo> ref_list; std::vector<BlockSizeContext::LogicalRefInfo> logical_ref_list;
+		BlockSizeContext size_context(ref_list, logical_ref_list); Size(size_context, *block);
+		data_t block_size = size_context.GetSize(); align_offset<data_t>(block_size);
+		VisitBlock(context, index, block_size);
+		for (auto& ref : ref_list) { ScanRef(context, *ref.index, *ref.type); }
+		for (auto& ref : logical_ref_list) { ScanLogicalRef(context, index, ref.id, *ref.type); }
+	}
+public:
+	// pattern is advised over the committed file before the scan, Normal leaves paging alone
+	template<class T, class Visitor>
+	void Scan(const BlockRef<T>& root, Visitor visitor, BlockFile::AccessPattern pattern = BlockFile::AccessPattern::Normal) {
+		ScanBlocks(GetCommittedIndex(root), block_type_info<T>, visitor, nullptr, pattern);
+	}
+	template<class T>
+	BlockCheckResult Check(const BlockRef<T>& root, BlockFile::AccessPattern pattern = BlockFile::AccessPattern::Normal) {
+		BlockCheckResult result; std::mutex mutex;
+		ScanBlocks(GetCommittedIndex(root), block_type_info<T>,
+				   [&](data_t index, data_t length) {
+					   std::lock_guard<std::mutex> lock(mutex); result.block_count++; result.reachable_size += sizeof(data_t) + length;
+				   },
+				   [&](data_t index, const char* message) {
+					   std::lock_guard<std::mutex> lock(mutex); result.error_list.emplace_back(index, message);
+				   }, pattern);
+		result.total_size = GetFileSize() - meta_info_size;
+		return result;
 	}
 
 private:
 	template<class> friend class BlockPtr;
 	template<class> friend class BlockRef;
+	template<class> friend class LogicalRef;
+	template<class> friend class BlockReadAwaiter;
 	template<class, class> friend struct layout_traits;
 };
 
 
+template<class T>
+const BlockTypeInfo BlockManager::block_type_info = {
+	[](BlockSizeContext& context, const void* block) { Size(context, *static_cast<const T*>(block)); },
+	[](BlockManager& manager, data_t& index) { manager.SaveBlock<T>(index); },
+	[](BlockSaveContext& context, const void* block) { Save(context, *static_cast<const T*>(block)); },
+	[](BlockManager& manager, BlockScanContext& context, data_t index) { manager.ScanBlock<T>(context, index); },
+};
+
+
 template<class T>
 inline BlockPtr<const T>::~BlockPtr() {
-	this->reset(); if (!manager.IsNewBlock(index)) { manager.CheckCachedBlock(index); }
+	if (node != nullptr) { manager->ReleaseNode(node); }
 }
 
 template<class T>
@@ -217,21 +644,63 @@ inline BlockPtr<T> BlockRef<T>::Write() const {
 	return manager->WriteBlock<T>(index);
 }
 
+template<class T>
+inline void BlockRef<T>::Update(const T& block) const {
+	if (manager == nullptr) { throw std::invalid_argument("block ref uninitialized"); }
+	manager->UpdateBlock<T>(index, block);
+}
+
+template<class T>
+template<class K>
+inline auto BlockRef<T>::Find(const K& key) const {
+	if (manager == nullptr) { throw std::invalid_argument("block ref uninitialized"); }
+	return manager->FindBlock<T>(index, key);
+}
+
+template<class T>
+inline LogicalRef<T>::LogicalRef(BlockManager& manager) : manager(&manager), id(manager.CreateLogicalBlock<T>()) {}
+
+template<class T>
+inline BlockPtr<const T> LogicalRef<T>::Read() const {
+	if (manager == nullptr) { throw std::invalid_argument("logical ref uninitialized"); }
+	return manager->ReadLogicalBlock<T>(id);
+}
+
+template<class T>
+inline BlockPtr<T> LogicalRef<T>::Write() const {
+	if (manager == nullptr) { throw std::invalid_argument("logical ref uninitialized"); }
+	return manager->WriteLogicalBlock<T>(id);
+}
+
 
 template<class T>
 struct layout_traits<BlockRef<T>> {
 	static void Size(BlockSizeContext& context, const BlockRef<T>& object) {
-		context.add(object.index);
+		context.add_ref(object.manager, object.index, BlockManager::block_type_info<T>);
 	}
 	static void Load(BlockLoadContext& context, BlockRef<T>& object) {
 		data_t index; context.read(index); context.GetBlockManager().LoadBlockRef(object, index);
 	}
 	static void Save(BlockSaveContext& context, const BlockRef<T>& object) {
 		if (&context.GetBlockManager() != object.manager) { throw std::invalid_argument("block manager mismatch"); }
-		object.manager->SaveBlock<T>(object.index); object.manager->RenewSaveContext(context);
+		if (!BlockManager::is_const_block_index(object.index)) { throw std::runtime_error("block ref not saved"); }
 		context.write(object.index);
 	}
 };
 
+template<class T>
+struct layout_traits<LogicalRef<T>> {
+	static void Size(BlockSizeContext& context, const LogicalRef<T>& object) {
+		context.add_logical_ref(object.id, BlockManager::block_type_info<T>);
+	}
+	static void Load(BlockLoadContext& context, LogicalRef<T>& object) {
+		object.manager = &context.GetBlockManager(); context.read(object.id);
+	}
+	static void Save(BlockSaveContext& context, const LogicalRef<T>& object) {
+		if (&context.GetBlockManager() != object.manager) { throw std::invalid_argument("block manager mismatch"); }
+		context.write(object.id);
+	}
+};
+
 
 END_NAMESPACE(BlockStore)
\ No newline at end of file
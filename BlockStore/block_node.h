@@ -0,0 +1,40 @@
+#pragma once
+
+#include "core.h"
+
+#include <atomic>
+#include <optional>
+#include <memory_resource>
+
+
+BEGIN_NAMESPACE(BlockStore)
+
+
+struct BlockNode {
+	std::atomic<uint> ref_count;
+	const data_t index;
+	const void* const type;
+	std::optional<std::pmr::monotonic_buffer_resource> arena;  // backs pmr members of the object, released with the node
+
+	BlockNode(data_t index, const void* type) : ref_count(1), index(index), type(type) {}
+	virtual ~BlockNode() {}
+
+	void AddRef() { ref_count.fetch_add(1, std::memory_order_relaxed); }
+	bool TryAddRef() {  // fails once the count reached 0, the node may then be on its way out
+		uint count = ref_count.load(std::memory_order_relaxed);
+		while (count != 0 && !ref_count.compare_exchange_weak(count, count + 1, std::memory_order_acquire, std::memory_order_relaxed)) {}
+		return count != 0;
+	}
+	bool Release() { return ref_count.fetch_sub(1, std::memory_order_acq_rel) == 1; }
+};
+
+
+template<class T>
+struct BlockObject : BlockNode {
+	T object;
+
+	BlockObject(data_t index, const void* type) : BlockNode(index, type), object() {}
+};
+
+
+END_NAMESPACE(BlockStore)
\ No newline at end of file
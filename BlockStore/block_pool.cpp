@@ -0,0 +1,25 @@
+#include "block_pool.h"
+
+
+BEGIN_NAMESPACE(BlockStore)
+
+
+BlockPool::~BlockPool() {
+	for (byte* slab : slab_list) { ::operator delete(slab); }
+}
+
+alloc_ptr<byte> BlockPool::AllocateSlab() {
+	if (slab_used == slab_list.size()) { slab_list.push_back(static_cast<byte*>(::operator new(slab_size))); }
+	return slab_list[slab_used++];
+}
+
+void BlockPool::Release() {
+	if (live_count > 0) { return; }
+	size_class_list.fill(SizeClass());
+	for (data_t i = retained_slab_count; i < slab_list.size(); ++i) { ::operator delete(slab_list[i]); }
+	if (slab_list.size() > retained_slab_count) { slab_list.resize(retained_slab_count); }
+	slab_used = 0;
+}
+
+
+END_NAMESPACE(BlockStore)
\ No newline at end of file
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "uncopyable.h"
+
+#include <array>
+#include <vector>
+#include <new>
+
+
+BEGIN_NAMESPACE(BlockStore)
+
+
+class BlockPool : Uncopyable {
+public:
+	BlockPool() {}
+	~BlockPool();
+
+	// slab
+private:
+	static constexpr data_t slab_size = 64 * 1024;
+	static constexpr data_t retained_slab_count = 16;
+private:
+	std::vector<alloc_ptr<byte>> slab_list;
+	data_t slab_used = 0;
+private:
+	alloc_ptr<byte> AllocateSlab();
+
+	// size class
+private:
+	static constexpr data_t size_granularity = 16;
+	static constexpr data_t max_pooled_size = 1024;
+	static constexpr data_t size_class_count = max_pooled_size / size_granularity;
+private:
+	struct FreeNode {
+		ref_ptr<FreeNode> next;
+	};
+	struct SizeClass {
+		ref_ptr<FreeNode> free_list = nullptr;
+		byte* curr = nullptr;
+		byte* end = nullptr;
+	};
+	std::array<SizeClass, size_class_count> size_class_list;
+	data_t live_count = 0;
+private:
+	static bool is_pooled(data_t size, data_t alignment) { return size <= max_pooled_size && alignment <= size_granularity; }
+public:
+	void* Allocate(data_t size, data_t alignment) {
+		if (!is_pooled(size, alignment)) { return ::operator new(size, std::align_val_t(alignment)); }
+		SizeClass& size_class = size_class_list[(size - 1) / size_granularity]; ++live_count;
+		if (size_class.free_list != nullptr) {
+			FreeNode* node = size_class.free_list; size_class.free_list = node->next; return node;
+		}
+		data_t block_size = ((size - 1) / size_granularity + 1) * size_granularity;
+		if ((data_t)(size_class.end - size_class.curr) < block_size) {
+			size_class.curr = AllocateSlab(); size_class.end = size_class.curr + slab_size;
+		}
+		void* ptr = size_class.curr; size_class.curr += block_size; return ptr;
+	}
+	void Deallocate(void* ptr, data_t size, data_t alignment) {
+		if (!is_pooled(size, alignment)) { return ::operator delete(ptr, std::align_val_t(alignment)); }
+		SizeClass& size_class = size_class_list[(size - 1) / size_granularity]; --live_count;
+		FreeNode* node = static_cast<FreeNode*>(ptr); node->next = size_class.free_list; size_class.free_list = node;
+	}
+	void Release();
+};
+
+
+template<class T>
+struct BlockAllocator {
+	using value_type = T;
+	ref_ptr<BlockPool> pool;
+	BlockAllocator(BlockPool& pool) : pool(&pool) {}
+	template<class U> BlockAllocator(const BlockAllocator<U>& other) : pool(other.pool) {}
+	T* allocate(size_t count) { return static_cast<T*>(pool->Allocate(sizeof(T) * count, alignof(T))); }
+	void deallocate(T* ptr, size_t count) { pool->Deallocate(ptr, sizeof(T) * count, alignof(T)); }
+	template<class U> bool operator==(const BlockAllocator<U>& other) const { return pool == other.pool; }
+	template<class U> bool operator!=(const BlockAllocator<U>& other) const { return pool != other.pool; }
+};
+
+
+END_NAMESPACE(BlockStore)
\ No newline at end of file
@@ -1,6 +1,6 @@
 #pragma once
 
-#include "core.h"
+#include "block_node.h"
 
 #include <memory>
 
@@ -9,6 +9,9 @@ BEGIN_NAMESPACE(BlockStore)
 
 class BlockManager;
 
+template<class T>
+class BlockReadAwaiter;
+
 
 template<class T>
 class BlockPtr : public std::shared_ptr<T> {
@@ -20,17 +23,38 @@ public:
 };
 
 template<class T>
-class BlockPtr<const T> : public std::shared_ptr<const T> {
+class BlockPtr<const T> {
 private:
-	BlockManager& manager;
-	mutable data_t index;
+	const T* ptr;
+	ref_ptr<BlockNode> node;
+	std::shared_ptr<const T> new_block;
+	ref_ptr<BlockManager> manager;
+private:
+	BlockPtr(BlockManager& manager, BlockNode& node) : ptr(&static_cast<BlockObject<T>&>(node).object), node(&node), manager(&manager) {}
+	BlockPtr(std::shared_ptr<const T> new_block) : ptr(new_block.get()), node(nullptr), new_block(std::move(new_block)), manager(nullptr) {}
 public:
-	BlockPtr(std::shared_ptr<const T> ptr, BlockManager& manager, data_t index) :
-		std::shared_ptr<const T>(ptr), manager(manager), index(index) {}
+	BlockPtr() : ptr(nullptr), node(nullptr), manager(nullptr) {}
+	BlockPtr(BlockPtr&& other) noexcept : ptr(other.ptr), node(other.node), new_block(std::move(other.new_block)), manager(other.manager) {
+		other.ptr = nullptr; other.node = nullptr;
+	}
+	BlockPtr(const BlockPtr& other) : ptr(other.ptr), node(other.node), new_block(other.new_block), manager(other.manager) {
+		if (node != nullptr) { node->AddRef(); }
+	}
 	~BlockPtr();
 public:
-	operator const T& () const { return *this->get(); }
-	operator const T* () const { return this->get(); }
+	void swap(BlockPtr& other) noexcept {
+		std::swap(ptr, other.ptr); std::swap(node, other.node); new_block.swap(other.new_block); std::swap(manager, other.manager);
+	}
+	BlockPtr& operator=(BlockPtr other) noexcept { swap(other); return *this; }
+public:
+	const T* get() const { return ptr; }
+	const T& operator*() const { return *ptr; }
+	const T* operator->() const { return ptr; }
+	explicit operator bool() const { return ptr != nullptr; }
+	operator const T& () const { return *ptr; }
+	operator const T* () const { return ptr; }
+private:
+	friend class BlockManager;
 };
 
 
@@ -55,11 +79,37 @@ public:
 	bool operator!=(const BlockRef& other) const { return !operator==(other); }
 public:
 	BlockPtr<const T> Read() const;
+	BlockReadAwaiter<T> ReadAsync() const;
 	BlockPtr<T> Write() const;
+	void Update(const T& block) const;
+	template<class K> auto Find(const K& key) const;
 private:
 	friend class BlockManager;
+	friend class BlockReadAwaiter<T>;
 	friend struct layout_traits<BlockRef>;
 };
 
 
+template<class T>
+class LogicalRef {
+private:
+	ref_ptr<BlockManager> manager;
+	data_t id;
+public:
+	LogicalRef() : manager(nullptr), id(block_index_invalid) {}
+	LogicalRef(BlockManager& manager);
+public:
+	BlockManager& GetManager() const { return *manager; }
+	data_t GetId() const { return id; }
+	bool operator==(const LogicalRef& other) const { return manager == other.manager && id == other.id; }
+	bool operator!=(const LogicalRef& other) const { return !operator==(other); }
+public:
+	BlockPtr<const T> Read() const;
+	BlockPtr<T> Write() const;
+private:
+	friend class BlockManager;
+	friend struct layout_traits<LogicalRef>;
+};
+
+
 END_NAMESPACE(BlockStore)
\ No newline at end of file
@@ -0,0 +1,164 @@
+#include "buffered_file.h"
+
+#include <Windows.h>
+
+#include <algorithm>
+
+
+BEGIN_NAMESPACE(BlockStore)
+
+
+BufferedFile::BufferedFile(const wchar path[], uint64 page_size, data_t page_count,
+						   CreateMode create_mode, AccessMode access_mode, ShareMode share_mode, bool direct_io) :
+	file(INVALID_HANDLE_VALUE), size(0), access_mode(access_mode),
+	page_size(page_size), frame_memory(nullptr), frame_list(page_count), clock_hand(0), uncached_data(nullptr), access_pattern(AccessPattern::Normal) {
+	if (page_size == 0 || page_size % 4096 != 0 || page_size > 0x40000000) { throw std::invalid_argument("invalid page size"); }
+	if (page_count == 0) { throw std::invalid_argument("invalid page count"); }
+	DWORD flags = FILE_ATTRIBUTE_NORMAL | (direct_io ? FILE_FLAG_NO_BUFFERING : 0);
+	file = CreateFileW(path, (DWORD)access_mode, (DWORD)share_mode, NULL, (DWORD)create_mode, flags, NULL);
+	if (file == INVALID_HANDLE_VALUE) { throw std::runtime_error("create file error"); }
+	if (GetFileSizeEx(file, (PLARGE_INTEGER)&size) != TRUE) { CloseHandle(file); throw std::runtime_error("get file size error"); }
+	frame_memory = (byte*)VirtualAlloc(NULL, page_size * (page_count + 1), MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+	if (frame_memory == NULL) { CloseHandle(file); throw std::runtime_error("allocate buffer pool error"); }
+	for (data_t index = 0; index < page_count; ++index) { frame_list[index].data = frame_memory + index * page_size; }
+	uncached_data = frame_memory + page_count * page_size;
+}
+
+BufferedFile::~BufferedFile() {
+	if (!IsReadOnly()) { try { Flush(); } catch (std::runtime_error&) {} }
+	VirtualFree(frame_memory, 0, MEM_RELEASE);
+	CloseHandle(file);
+}
+
+void BufferedFile::SetFileSize(uint64 size) {
+	if (SetFilePointerEx(file, (LARGE_INTEGER&)size, NULL, FILE_BEGIN) != TRUE) { throw std::runtime_error("set file pointer error"); }
+	if (SetEndOfFile(file) != TRUE) { throw std::runtime_error("set end of file error"); }
+}
+
+void BufferedFile::SetSize(uint64 size) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (this->size == size) { return; }
+	if (size < this->size) {
+		uint64 end_page = (size + page_size - 1) / page_size;
+		for (Frame& frame : frame_list) {
+			if (frame.page == block_index_invalid) { continue; }
+			if (frame.page >= end_page) {
+				if (frame.pin_count > 0) { throw std::runtime_error("page is locked"); }
+				DropFrame(frame);
+			} else if (frame.page == size / page_size) {
+				memset(frame.data + size % page_size, 0, page_size - size % page_size);
+			}
+		}
+	}
+	SetFileSize(size);
+	this->size = size;
+}
+
+bool BufferedFile::Refresh() {
+	std::lock_guard<std::mutex> lock(mutex);
+	uint64 size; if (GetFileSizeEx(file, (PLARGE_INTEGER)&size) != TRUE) { throw std::runtime_error("get file size error"); }
+	for (Frame& frame : frame_list) {
+		if (frame.page == block_index_invalid || frame.pin_count > 0 || frame.dirty) { continue; }
+		if (frame.page == 0 || frame.page >= this->size / page_size) { DropFrame(frame); }  // meta page and old tail may have changed
+	}
+	bool changed = this->size != size; this->size = size;
+	return changed;
+}
+
+void BufferedFile::ReadPage(Frame& frame) const {
+	uint64 offset = frame.page * page_size;
+	OVERLAPPED overlapped = {}; overlapped.Offset = (DWORD)offset; overlapped.OffsetHigh = (DWORD)(offset >> 32);
+	DWORD length = 0;
+	if (ReadFile(file, frame.data, (DWORD)page_size, &length, &overlapped) != TRUE && GetLastError() != ERROR_HANDLE_EOF) {
+		throw std::runtime_error("read file error");
+	}
+	memset(frame.data + length, 0, page_size - length);
+}
+
+void BufferedFile::WritePage(Frame& frame) const {
+	uint64 offset = frame.page * page_size;
+	OVERLAPPED overlapped = {}; overlapped.Offset = (DWORD)offset; overlapped.OffsetHigh = (DWORD)(offset >> 32);
+	DWORD length = 0;
+	if (WriteFile(file, frame.data, (DWORD)page_size, &length, &overlapped) != TRUE || length != page_size) {
+		throw std::runtime_error("write file error");
+	}
+	frame.dirty = false;
+}
+
+BufferedFile::Frame& BufferedFile::GetFrame(uint64 page, std::unique_lock<std::mutex>& lock) const {
+	for (;;) {
+		if (auto it = page_map.find(page); it != page_map.end()) { Frame& frame = frame_list[it->second]; frame.referenced = true; return frame; }
+		for (data_t step = 0; step < frame_list.size() * 2; ++step) {
+			Frame& frame = frame_list[clock_hand]; clock_hand = (clock_hand + 1) % frame_list.size();
+			if (frame.pin_count > 0) { continue; }
+			if (frame.referenced) { frame.referenced = false; continue; }
+			if (frame.page != block_index_invalid) { if (frame.dirty) { WritePage(frame); } DropFrame(frame); }
+			frame.page = page;
+			try {
+				ReadPage(frame);
+			} catch (...) {
+				frame.page = block_index_invalid; throw;
+			}
+			frame.referenced = true; page_map.emplace(page, &frame - frame_list.data());
+			return frame;
+		}
+		unpin_condition.wait(lock);  // every frame is pinned, wait for an Unlock
+	}
+}
+
+void BufferedFile::DropFrame(Frame& frame) const {
+	page_map.erase(frame.page); frame.page = block_index_invalid; frame.dirty = false; frame.referenced = false;
+}
+
+void BufferedFile::CopyPages(uint64 offset, byte* data, uint64 length, bool dirty, std::unique_lock<std::mutex>& lock) const {
+	for (uint64 end = offset + length, extent; offset < end; offset += extent, data += extent) {
+		Frame& frame = GetFrame(offset / page_size, lock); extent = std::min(end - offset, page_size - offset % page_size);
+		if (dirty) { memcpy(frame.data + offset % page_size, data, extent); frame.dirty = true; } else { memcpy(data, frame.data + offset % page_size, extent); }
+	}
+}
+
+byte* BufferedFile::Lock(uint64 offset, uint64 length) const {
+	if (offset > size || length > size - offset) { throw std::runtime_error("invalid offset or length"); }
+	std::unique_lock<std::mutex> lock(mutex);
+	if (offset % page_size + length > page_size) {
+		std::unique_ptr<byte[]> span(new byte[length]); CopyPages(offset, span.get(), length, false, lock);
+		return span_map.emplace(offset, std::move(span))->second.get();
+	}
+	Frame& frame = GetFrame(offset / page_size, lock); ++frame.pin_count;
+	return frame.data + offset % page_size;
+}
+
+void BufferedFile::Unlock(uint64 offset, uint64 length, bool dirty) const {
+	std::unique_lock<std::mutex> lock(mutex);
+	if (offset % page_size + length > page_size) {
+		auto it = span_map.find(offset); if (it == span_map.end()) { return; }
+		std::unique_ptr<byte[]> span = std::move(it->second); span_map.erase(it);
+		if (dirty) { CopyPages(offset, span.get(), length, true, lock); }
+		return;
+	}
+	if (auto it = page_map.find(offset / page_size); it != page_map.end()) {
+		Frame& frame = frame_list[it->second]; frame.dirty |= dirty;
+		if (--frame.pin_count == 0) { unpin_condition.notify_all(); }
+	}
+}
+
+void BufferedFile::ReadUncached(uint64 offset, void* data, uint64 length) const {
+	if (offset % page_size + length > page_size) { throw std::runtime_error("uncached read spans pages"); }
+	std::lock_guard<std::mutex> lock(uncached_mutex);
+	Frame frame; frame.page = offset / page_size; frame.data = uncached_data; ReadPage(frame);
+	memcpy(data, uncached_data + offset % page_size, length);
+}
+
+void BufferedFile::Flush() {
+	std::lock_guard<std::mutex> lock(mutex);
+	std::vector<ref_ptr<Frame>> dirty_list;
+	for (Frame& frame : frame_list) { if (frame.dirty) { dirty_list.push_back(&frame); } }
+	auto write_order = [](const Frame* frame) { return frame->page == 0 ? block_index_invalid : frame->page; };  // meta page last
+	std::sort(dirty_list.begin(), dirty_list.end(), [&](const Frame* a, const Frame* b) { return write_order(a) < write_order(b); });
+	for (Frame* frame : dirty_list) { WritePage(*frame); }
+	uint64 file_size; if (GetFileSizeEx(file, (PLARGE_INTEGER)&file_size) != TRUE) { throw std::runtime_error("get file size error"); }
+	if (file_size != size) { SetFileSize(size); }
+}
+
+
+END_NAMESPACE(BlockStore)
\ No newline at end of file
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "file_manager.h"
+
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+
+
+BEGIN_NAMESPACE(BlockStore)
+
+
+class BufferedFile : public BlockFile {
+public:
+	using CreateMode = FileManager::CreateMode;
+	using AccessMode = FileManager::AccessMode;
+	using ShareMode = FileManager::ShareMode;
+public:
+	BufferedFile(const wchar path[],
+				 uint64 page_size,
+				 data_t page_count,
+				 CreateMode create_mode = CreateMode::OpenAlways,
+				 AccessMode access_mode = AccessMode::ReadWrite,
+				 ShareMode share_mode = ShareMode::None,
+				 bool direct_io = false);
+	virtual ~BufferedFile() override;
+private:
+	using HANDLE = void*;
+	HANDLE file;
+	uint64 size;
+	AccessMode access_mode;
+private:
+	void SetFileSize(uint64 size);
+public:
+	virtual bool IsReadOnly() const override { return access_mode == AccessMode::ReadOnly; }
+	virtual uint64 GetSize() const override { return size; }
+	virtual void SetSize(uint64 size) override;
+	virtual bool Refresh() override;
+
+	// buffer pool
+private:
+	struct Frame {
+		uint64 page = block_index_invalid;
+		uint pin_count = 0;
+		bool dirty = false;
+		bool referenced = false;
+		byte* data = nullptr;
+	};
+	const uint64 page_size;
+	byte* frame_memory;
+	mutable std::vector<Frame> frame_list;
+	mutable std::unordered_map<uint64, data_t> page_map;
+	mutable data_t clock_hand;
+	mutable std::mutex mutex;
+	mutable std::condition_variable unpin_condition;
+	mutable std::unordered_multimap<uint64, std::unique_ptr<byte[]>> span_map;  // copies of ranges that span pages
+	byte* uncached_data;
+	mutable std::mutex uncached_mutex;
+private:
+	void ReadPage(Frame& frame) const;
+	void WritePage(Frame& frame) const;
+	Frame& GetFrame(uint64 page, std::unique_lock<std::mutex>& lock) const;
+	void DropFrame(Frame& frame) const;
+	void CopyPages(uint64 offset, byte* data, uint64 length, bool dirty, std::unique_lock<std::mutex>& lock) const;
+public:
+	virtual uint64 GetSegmentSize() const override { return 0; }
+	virtual byte* Lock(uint64 offset, uint64 length) const override;
+	virtual void Unlock(uint64 offset, uint64 length, bool dirty) const override;
+	virtual void Flush() override;
+	virtual void ReadUncached(uint64 offset, void* data, uint64 length) const override;
+
+	// access pattern
+private:
+	AccessPattern access_pattern;
+public:
+	virtual AccessPattern GetAccessPattern() const override { return access_pattern; }
+	virtual void SetAccessPattern(AccessPattern pattern) override { access_pattern = pattern; }
+	virtual void Advise(uint64 offset, uint64 length, AccessPattern pattern) const override {}  // the pool has its own replacement policy
+};
+
+
+END_NAMESPACE(BlockStore)
\ No newline at end of file
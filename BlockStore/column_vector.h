@@ -0,0 +1,107 @@
+#pragma once
+
+#include "stl_helper.h"
+
+
+BEGIN_NAMESPACE(BlockStore)
+
+
+template<class T>
+class column_vector : public std::vector<T> {
+public:
+	using std::vector<T>::vector;
+};
+
+
+template<class T, class = void>
+struct column_traits {
+	template<class Get> static void Size(BlockSizeContext& context, data_t count, Get get) {
+		for (data_t index = 0; index < count; ++index) { BlockStore::Size(context, get(index)); }
+	}
+	template<class Get> static void Load(BlockLoadContext& context, data_t count, Get get) {
+		for (data_t index = 0; index < count; ++index) { BlockStore::Load(context, get(index)); }
+	}
+	template<class Get> static void Save(BlockSaveContext& context, data_t count, Get get) {
+		for (data_t index = 0; index < count; ++index) { BlockStore::Save(context, get(index)); }
+	}
+};
+
+template<class T>
+struct column_traits<T, std::enable_if_t<has_trivial_layout<T>>> {
+	template<class Get> static void Size(BlockSizeContext& context, data_t count, Get get) {
+		context.add<T>(nullptr, count);
+	}
+	template<class Get> static void Load(BlockLoadContext& context, data_t count, Get get) {
+		const T* column = context.view<T>(count); for (data_t index = 0; index < count; ++index) { get(index) = column[index]; }
+	}
+	template<class Get> static void Save(BlockSaveContext& context, data_t count, Get get) {
+		T* column = context.view<T>(count); for (data_t index = 0; index < count; ++index) { column[index] = get(index); }
+	}
+};
+
+template<class T>
+struct column_traits<std::basic_string<T>, std::enable_if_t<has_trivial_layout<T>>> {
+	template<class Get> static void Size(BlockSizeContext& context, data_t count, Get get) {
+		data_t total = 0; for (data_t index = 0; index < count; ++index) { total += get(index).size(); }
+		context.add<data_t>(nullptr, count); context.add<T>(nullptr, total);
+	}
+	template<class Get> static void Load(BlockLoadContext& context, data_t count, Get get) {
+		const data_t* length = context.view<data_t>(count);
+		data_t total = 0; for (data_t index = 0; index < count; ++index) { total += length[index]; }
+		const T* blob = context.view<T>(total);
+		for (data_t index = 0, offset = 0; index < count; offset += length[index++]) {
+			auto& item = get(index); item.resize(length[index]); memcpy(item.data(), blob + offset, length[index] * sizeof(T));
+		}
+	}
+	template<class Get> static void Save(BlockSaveContext& context, data_t count, Get get) {
+		data_t* length = context.view<data_t>(count);
+		data_t total = 0; for (data_t index = 0; index < count; ++index) { total += length[index] = get(index).size(); }
+		T* blob = context.view<T>(total);
+		for (data_t index = 0, offset = 0; index < count; offset += length[index++]) { memcpy(blob + offset, get(index).data(), length[index] * sizeof(T)); }
+	}
+};
+
+template<class T>
+struct column_traits<T, std::enable_if_t<has_custom_layout<T>>> {
+private:
+	template<class P> struct member_pointer;
+	template<class M> struct member_pointer<M T::*> { using type = M; };
+	template<class P> using member_type = typename member_pointer<P>::type;
+	template<class M, class Get> static auto member_getter(M T::* member, Get& get) {
+		return [member, &get](data_t index) -> decltype(auto) { return (get(index).*member); };
+	}
+public:
+	template<class Get> static void Size(BlockSizeContext& context, data_t count, Get get) {
+		std::apply([&](auto... member) {
+			(column_traits<member_type<decltype(member)>>::Size(context, count, member_getter(member, get)), ...);
+		}, layout(layout_type<T>()));
+	}
+	template<class Get> static void Load(BlockLoadContext& context, data_t count, Get get) {
+		std::apply([&](auto... member) {
+			(column_traits<member_type<decltype(member)>>::Load(context, count, member_getter(member, get)), ...);
+		}, layout(layout_type<T>()));
+	}
+	template<class Get> static void Save(BlockSaveContext& context, data_t count, Get get) {
+		std::apply([&](auto... member) {
+			(column_traits<member_type<decltype(member)>>::Save(context, count, member_getter(member, get)), ...);
+		}, layout(layout_type<T>()));
+	}
+};
+
+
+template<class T>
+struct layout_traits<column_vector<T>> {
+	static void Size(BlockSizeContext& context, const column_vector<T>& object) {
+		context.add(object.size()); column_traits<T>::Size(context, object.size(), [&](data_t index) -> const T& { return object[index]; });
+	}
+	static void Load(BlockLoadContext& context, column_vector<T>& object) {
+		data_t count; context.read(count); object.resize(count);
+		column_traits<T>::Load(context, count, [&](data_t index) -> T& { return object[index]; });
+	}
+	static void Save(BlockSaveContext& context, const column_vector<T>& object) {
+		context.write(object.size()); column_traits<T>::Save(context, object.size(), [&](data_t index) -> const T& { return object[index]; });
+	}
+};
+
+
+END_NAMESPACE(BlockStore)
\ No newline at end of file
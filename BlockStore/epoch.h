@@ -0,0 +1,64 @@
+#pragma once
+
+#include "uncopyable.h"
+
+#include <atomic>
+#include <array>
+
+
+BEGIN_NAMESPACE(BlockStore)
+
+
+class EpochDomain : Uncopyable {
+private:
+	static constexpr uint slot_count = 256;
+	static constexpr uint64 epoch_idle = (uint64)-1;
+	struct alignas(64) Slot {
+		std::atomic<uint64> epoch = epoch_idle;
+		std::atomic<bool> owned = false;
+	};
+	struct ThreadSlot {
+		ref_ptr<Slot> slot = nullptr;
+		uint depth = 0;
+		~ThreadSlot() { if (slot != nullptr) { slot->owned.store(false, std::memory_order_release); } }
+	};
+private:
+	std::atomic<uint64> global_epoch = 0;
+	std::array<Slot, slot_count> slot_list;
+private:
+	EpochDomain() {}
+	static EpochDomain& Get() { static EpochDomain domain; return domain; }
+	static ThreadSlot& GetThreadSlot() {
+		thread_local ThreadSlot thread_slot;
+		if (thread_slot.slot == nullptr) {
+			for (Slot& slot : Get().slot_list) {
+				if (!slot.owned.load(std::memory_order_relaxed) && !slot.owned.exchange(true, std::memory_order_acquire)) { thread_slot.slot = &slot; break; }
+			}
+		}
+		return thread_slot;
+	}
+public:
+	class Guard : Uncopyable {
+	private:
+		ThreadSlot& thread_slot;
+	public:
+		Guard() : thread_slot(GetThreadSlot()) {
+			if (thread_slot.slot != nullptr && thread_slot.depth++ == 0) { thread_slot.slot->epoch.store(Get().global_epoch.load()); }  // announced before any shared pointer is read
+		}
+		~Guard() {
+			if (thread_slot.slot != nullptr && --thread_slot.depth == 0) { thread_slot.slot->epoch.store(epoch_idle, std::memory_order_release); }
+		}
+	public:
+		bool IsActive() const { return thread_slot.slot != nullptr; }  // false once every slot is taken, the caller then locks
+	};
+public:
+	static uint64 GetEpoch() { return Get().global_epoch.load(); }  // tags a pointer after it was unlinked
+	static uint64 Synchronize() {  // pointers tagged below the result are no longer reachable by any guard
+		EpochDomain& domain = Get(); uint64 safe_epoch = domain.global_epoch.fetch_add(1) + 1;
+		for (Slot& slot : domain.slot_list) { uint64 epoch = slot.epoch.load(); if (epoch < safe_epoch) { safe_epoch = epoch; } }
+		return safe_epoch;
+	}
+};
+
+
+END_NAMESPACE(BlockStore)
\ No newline at end of file
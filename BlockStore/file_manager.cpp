@@ -2,6 +2,8 @@
 
 #include <Windows.h>
 
+#include <algorithm>
+
 
 BEGIN_NAMESPACE(BlockStore)
 
@@ -9,8 +11,6 @@ BEGIN_NAMESPACE(Anonymous)
 
 static_assert(sizeof(LARGE_INTEGER) == sizeof(uint64));
 
-static const uint64 allocation_granularity = []() { SYSTEM_INFO info; GetSystemInfo(&info); return info.dwAllocationGranularity; }();
-
 struct Interval {
 	uint64 begin;
 	uint64 length;
@@ -25,11 +25,6 @@ struct Interval {
 	bool Contains(const Interval& interval) const { return interval.left() >= left() && interval.right() <= right(); }
 };
 
-uint64 align_offset_floor(uint64 offset, uint64 alignment) {
-	assert((alignment & (alignment - 1)) == 0);  // power of 2
-	return offset & ~(alignment - 1);
-}
-
 uint64 align_offset_ceil(uint64 offset, uint64 alignment) {
 	assert((alignment & (alignment - 1)) == 0);  // power of 2
 	return (offset + (alignment - 1)) & ~(alignment - 1);
@@ -40,54 +35,181 @@ END_NAMESPACE(Anonymous)
 
 FileManager::FileManager(const wchar path[], CreateMode create_mode, AccessMode access_mode, ShareMode share_mode) :
 	file(INVALID_HANDLE_VALUE), size(0), create_mode(create_mode), access_mode(access_mode), share_mode(share_mode),
-	mapping(NULL), view_address(nullptr), view_offset(0), view_length(0) {
+	mapping(NULL), access_pattern(AccessPattern::Normal) {
 	file = CreateFileW(path, (DWORD)access_mode, (DWORD)share_mode, NULL, (DWORD)create_mode, FILE_ATTRIBUTE_NORMAL, NULL);
 	if (file == INVALID_HANDLE_VALUE) { throw std::runtime_error("create file error"); }
-	if (GetFileSizeEx(file, (PLARGE_INTEGER)&size) != TRUE) { throw std::runtime_error("get file size error"); }
-	DoMapping();
+	uint64 size; if (GetFileSizeEx(file, (PLARGE_INTEGER)&size) != TRUE) { throw std::runtime_error("get file size error"); }
+	DoMapping(size);
 }
 
 FileManager::~FileManager() {
 	UndoMapping();
+	if (!IsReadOnly()) { TruncateFile(size); }  // best effort, fails while another process still maps the reserve
 	CloseHandle(file);
 }
 
 void FileManager::SetSize(uint64 size) {
-	if (this->size != size) {
-		UndoMapping();
-		if (SetFilePointerEx(file, (LARGE_INTEGER&)size, NULL, FILE_BEGIN) != TRUE) { throw std::runtime_error("set file pointer error"); }
-		if (SetEndOfFile(file) != TRUE) { throw std::runtime_error("set end of file error"); }
-		this->size = size;
-		DoMapping();
+	if (this->size == size) { return; }
+	if (size < this->size) { return ShrinkMapping(size); }
+	DoMapping(size);  // a larger mapping extends the file
+}
+
+bool FileManager::Refresh() {
+	uint64 size; if (GetFileSizeEx(file, (PLARGE_INTEGER)&size) != TRUE) { throw std::runtime_error("get file size error"); }
+	if (this->size == size) { return false; }
+	if (size < this->size) { std::lock_guard<std::mutex> lock(view_mutex); this->size = size; return true; }  // views keep the old tail mapped
+	DoMapping(size);
+	return true;
+}
+
+bool FileManager::TruncateFile(uint64 size) {
+	return SetFilePointerEx(file, (LARGE_INTEGER&)size, NULL, FILE_BEGIN) == TRUE && SetEndOfFile(file) == TRUE;
+}
+
+void FileManager::DoMapping(uint64 size) {
+	if (size > 0) {
+		HANDLE mapping = CreateFileMappingW(file, NULL, IsReadOnly() ? PAGE_READONLY : PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)size, NULL);
+		if (mapping == NULL) { throw std::runtime_error("create file mapping error"); }
+		std::lock_guard<std::mutex> lock(view_mutex);
+		if (this->mapping != NULL) { CloseHandle(this->mapping); }  // mapped views keep the old mapping alive
+		this->mapping = mapping;
 	}
+	this->size = size;  // published after the mapping, so readers never map past it
+	if (access_pattern == AccessPattern::Populate) { Advise(0, size, access_pattern); }
 }
 
-void FileManager::DoMapping() {
-	if (size == 0) { return; }
-	mapping = CreateFileMappingW(file, NULL, access_mode == AccessMode::ReadOnly ? PAGE_READONLY : PAGE_READWRITE, 0, 0, NULL);
-	if (mapping == NULL) { throw std::runtime_error("create file mapping error"); }
+void FileManager::ShrinkMapping(uint64 size) {
+	std::lock_guard<std::mutex> lock(view_mutex);
+	this->size = size;  // the tail is unreachable from here on, trimmed or not
+	if (share_mode != ShareMode::None) { return; }  // other processes may map the tail, it stays as reserve
+	for (auto& table : view_table_list) {
+		for (ViewSlot& slot : *table) {
+			if (const View* view = slot.view.exchange(nullptr); view != nullptr) { retired_view_list.emplace_back(&slot, const_cast<View*>(view)); }
+		}
+	}
+	UnmapRetiredViews();
+	if (!retired_view_list.empty() || !large_view_list.empty()) { return; }  // a pinned view keeps the reserve until the next shrink
+	if (mapping != NULL) { CloseHandle(mapping); mapping = NULL; }  // a mapped file cannot be truncated
+	if (!TruncateFile(size)) { throw std::runtime_error("set end of file error"); }
+	if (size > 0) {
+		mapping = CreateFileMappingW(file, NULL, IsReadOnly() ? PAGE_READONLY : PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)size, NULL);
+		if (mapping == NULL) { throw std::runtime_error("create file mapping error"); }
+	}
 }
 
 void FileManager::UndoMapping() {
-	Unlock();
+	for (auto& table : view_table_list) { for (ViewSlot& slot : *table) { delete slot.view.load(std::memory_order_relaxed); } }
+	for (auto& table : view_directory) { table.store(nullptr, std::memory_order_relaxed); }
+	view_table_list.clear(); large_view_list.clear(); retired_view_list.clear();
 	if (mapping != NULL) { CloseHandle(mapping); mapping = NULL; }
 }
 
-void FileManager::Unlock() {
-	if (view_address != nullptr) { UnmapViewOfFile(view_address); view_address = nullptr; view_offset = 0; view_length = 0; }
-}
+FileManager::View::~View() { UnmapViewOfFile(address); }
 
-byte* FileManager::Lock(uint64 offset, uint64 length) {
+std::unique_ptr<FileManager::View> FileManager::MapView(uint64 offset, uint64 length) const {
 	if (mapping == NULL) { throw std::runtime_error("file mapping invalid"); }
+	byte* address = (byte*)MapViewOfFile(mapping, IsReadOnly() ? FILE_MAP_READ : (FILE_MAP_READ | FILE_MAP_WRITE), (DWORD)(offset >> 32), (DWORD)offset, (SIZE_T)length);
+	if (address == NULL) { throw std::runtime_error("map view of file error"); }
+	return std::unique_ptr<View>(new View{ offset, length, address });
+}
+
+FileManager::ViewSlot& FileManager::GetViewSlot(uint64 index) const {
+	if (index >= view_table_size * view_table_size) { throw std::runtime_error("file too large"); }
+	std::atomic<ViewTable*>& table_entry = view_directory[index / view_table_size];
+	ViewTable* table = table_entry.load(std::memory_order_acquire);
+	if (table == nullptr) {
+		std::lock_guard<std::mutex> lock(view_mutex);
+		if ((table = table_entry.load(std::memory_order_relaxed)) == nullptr) {
+			table = view_table_list.emplace_back(new ViewTable()).get(); table_entry.store(table, std::memory_order_release);
+		}
+	}
+	return (*table)[index % view_table_size];
+}
+
+void FileManager::UpdateView(ViewSlot& slot, uint64 index, uint64 end) const {
+	std::lock_guard<std::mutex> lock(view_mutex);
+	const View* view = slot.view.load(std::memory_order_relaxed);
+	if (view != nullptr && view->offset + view->length >= end) { return; }
+	uint64 view_offset = index * view_stride;
+	slot.view.store(MapView(view_offset, std::min(view_stride * 2, size.load() - view_offset)).release());  // ordered before the pin check below
+	if (view != nullptr) { retired_view_list.emplace_back(&slot, const_cast<View*>(view)); }
+	UnmapRetiredViews();
+}
+
+void FileManager::UnmapRetiredViews() const {
+	for (auto it = retired_view_list.begin(); it != retired_view_list.end();) {
+		if (it->first->pin_count.load() == 0) { it = retired_view_list.erase(it); } else { ++it; }
+	}
+}
+
+const FileManager::View& FileManager::GetLargeView(uint64 offset, uint64 length) const {
+	std::lock_guard<std::mutex> lock(view_mutex);
+	for (auto& view : large_view_list) { if (Interval(view->offset, view->length).Contains(Interval(offset, length))) { return *view; } }
+	uint64 view_offset = offset / view_stride * view_stride;
+	return *large_view_list.emplace_back(MapView(view_offset, std::min(align_offset_ceil(offset + length, view_stride), size.load()) - view_offset));
+}
+
+void FileManager::SetAccessPattern(AccessPattern pattern) {
+	access_pattern = pattern;
+	Advise(0, size, access_pattern);
+}
+
+void FileManager::Advise(uint64 offset, uint64 length, AccessPattern pattern) const {
+	if (length == 0) { return; }
 	if (!Interval(0, size).Contains(Interval(offset, length))) { throw std::runtime_error("invalid offset or length"); }
-	if (Interval(view_offset, view_length).Contains(Interval(offset, length))) { return view_address + offset - view_offset; }
-	Unlock();
-	uint64 view_begin = align_offset_floor(offset, allocation_granularity);
-	uint64 view_end = align_offset_ceil(offset + length, allocation_granularity); view_end = view_end <= size ? view_end : size;
-	view_offset = view_begin; view_length = view_end - view_begin;
-	view_address = (byte*)MapViewOfFile(mapping, access_mode == AccessMode::ReadOnly ? FILE_MAP_READ : (FILE_MAP_READ | FILE_MAP_WRITE), view_offset >> 32, (DWORD)view_offset, view_length);
-	if (view_address == NULL) { throw std::runtime_error("map view of file error"); }
-	return view_address + offset - view_offset;
+	for (uint64 end = offset + length, extent; offset < end; offset += extent) {
+		extent = std::min(end, (offset / view_stride + 1) * view_stride) - offset;
+		switch (pattern) {
+		case AccessPattern::Sequential:
+		case AccessPattern::Populate: {
+			WIN32_MEMORY_RANGE_ENTRY range = { Lock(offset, extent), (SIZE_T)extent };
+			PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);  // best effort, failure only loses the hint
+			Unlock(offset, extent, false);
+			break;
+		}
+		case AccessPattern::Random:
+			if (const View* view = GetViewSlot(offset / view_stride).view.load(); view != nullptr && view->offset + view->length >= offset + extent) {
+				VirtualUnlock(view->address + (offset - view->offset), (SIZE_T)extent);  // unlocked pages are removed from the working set
+			}
+			break;
+		default:
+			return;
+		}
+	}
+}
+
+byte* FileManager::Lock(uint64 offset, uint64 length) const {
+	if (!Interval(0, size).Contains(Interval(offset, length))) { throw std::runtime_error("invalid offset or length"); }
+	if (length > view_stride) { const View& view = GetLargeView(offset, length); return view.address + (offset - view.offset); }
+	uint64 index = GetViewIndex(offset, length); ViewSlot& slot = GetViewSlot(index);
+	slot.pin_count++;  // pinned before the view is read, so UpdateView never unmaps it under us
+	try {
+		for (;;) {
+			const View* view = slot.view.load();
+			if (view != nullptr && view->offset + view->length >= offset + length) { return view->address + (offset - view->offset); }
+			UpdateView(slot, index, offset + length);
+		}
+	} catch (...) {
+		slot.pin_count--; throw;
+	}
+}
+
+void FileManager::Unlock(uint64 offset, uint64 length, bool dirty) const {
+	if (length <= view_stride) { GetViewSlot(GetViewIndex(offset, length)).pin_count--; }
+}
+
+void FileManager::Flush() {
+	if (IsReadOnly()) { return; }
+	auto flush_view = [](const View& view) {
+		if (FlushViewOfFile(view.address, (SIZE_T)view.length) != TRUE) { throw std::runtime_error("flush view of file error"); }
+	};
+	{
+		std::lock_guard<std::mutex> lock(view_mutex);
+		for (auto& table : view_table_list) { for (ViewSlot& slot : *table) { if (const View* view = slot.view.load(); view != nullptr) { flush_view(*view); } } }
+		for (auto& view : large_view_list) { flush_view(*view); }
+		for (auto& [slot, view] : retired_view_list) { flush_view(*view); }
+	}
+	if (FlushFileBuffers(file) != TRUE) { throw std::runtime_error("flush file buffers error"); }  // views only reach the file cache
 }
 
 
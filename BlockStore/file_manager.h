@@ -1,12 +1,19 @@
 #pragma once
 
-#include "uncopyable.h"
+#include "block_file.h"
+
+#include <atomic>
+#include <array>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <mutex>
 
 
 BEGIN_NAMESPACE(BlockStore)
 
 
-class FileManager : Uncopyable {
+class FileManager : public BlockFile {
 public:
 	enum class CreateMode : uint {  // |  existing	 | not existing	|  
 		CreateNew = 1,				// | 	ERROR	 |	  create	|
@@ -29,30 +36,66 @@ public:
 				CreateMode create_mode = CreateMode::OpenAlways,
 				AccessMode access_mode = AccessMode::ReadWrite,
 				ShareMode share_mode = ShareMode::None);
-	~FileManager();
+	virtual ~FileManager() override;
 private:
 	using HANDLE = void*;
 	HANDLE file;
-	uint64 size;
+	std::atomic<uint64> size;
 	CreateMode create_mode;
 	AccessMode access_mode;
 	ShareMode share_mode;
 public:
-	uint64 GetSize() const { return size; }
-	void SetSize(uint64 size);
+	AccessMode GetAccessMode() const { return access_mode; }
+	virtual bool IsReadOnly() const override { return access_mode == AccessMode::ReadOnly; }
+	virtual uint64 GetSize() const override { return size; }
+	virtual void SetSize(uint64 size) override;
+	virtual bool Refresh() override;
 private:
 	HANDLE mapping;
 private:
-	void DoMapping();
+	void DoMapping(uint64 size);
+	void ShrinkMapping(uint64 size);
 	void UndoMapping();
+	bool TruncateFile(uint64 size);
+
+	// view
+private:
+	struct View {
+		uint64 offset;
+		uint64 length;
+		byte* address;
+		~View();
+	};
+	struct ViewSlot {
+		std::atomic<const View*> view;
+		std::atomic<uint> pin_count;  // Lock() calls not yet unlocked, a replaced view is unmapped once it drops to 0
+	};
+	static constexpr uint64 view_stride = 0x4000000;  // view i maps [i * stride, (i + 2) * stride), so any range up to a stride fits one view
+	static constexpr size_t view_table_size = 1024;
+	using ViewTable = std::array<ViewSlot, view_table_size>;
+	mutable std::atomic<ViewTable*> view_directory[view_table_size] = {};
+	mutable std::vector<std::unique_ptr<ViewTable>> view_table_list;
+	mutable std::vector<std::unique_ptr<View>> large_view_list;
+	mutable std::vector<std::pair<const ViewSlot*, std::unique_ptr<View>>> retired_view_list;
+	mutable std::mutex view_mutex;
 private:
-	byte* view_address;
-	uint64 view_offset;
-	uint64 view_length;
+	static uint64 GetViewIndex(uint64 offset, uint64 length) { return (length == 0 && offset > 0 ? offset - 1 : offset) / view_stride; }
+	std::unique_ptr<View> MapView(uint64 offset, uint64 length) const;
+	ViewSlot& GetViewSlot(uint64 index) const;
+	void UpdateView(ViewSlot& slot, uint64 index, uint64 end) const;
+	void UnmapRetiredViews() const;
+	const View& GetLargeView(uint64 offset, uint64 length) const;
 private:
-	void Unlock();
+	AccessPattern access_pattern;
+public:
+	virtual AccessPattern GetAccessPattern() const override { return access_pattern; }
+	virtual void SetAccessPattern(AccessPattern pattern) override;
+	virtual void Advise(uint64 offset, uint64 length, AccessPattern pattern) const override;
 public:
-	byte* Lock(uint64 offset, uint64 length);
+	virtual uint64 GetSegmentSize() const override { return 0; }
+	virtual byte* Lock(uint64 offset, uint64 length) const override;
+	virtual void Unlock(uint64 offset, uint64 length, bool dirty) const override;
+	virtual void Flush() override;
 };
 
 
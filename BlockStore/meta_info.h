@@ -9,6 +9,8 @@ BEGIN_NAMESPACE(BlockStore)
 struct MetaInfo {
 	data_t file_size = 0;
 	data_t root_index = block_index_invalid;
+	data_t fingerprint_index = block_index_invalid;
+	data_t logical_index = block_index_invalid;
 };
 
 constexpr data_t meta_info_size = sizeof(MetaInfo);
@@ -0,0 +1,91 @@
+#include "segmented_file.h"
+
+#include <filesystem>
+
+
+BEGIN_NAMESPACE(BlockStore)
+
+
+SegmentedFile::SegmentedFile(path_function segment_path, uint64 segment_size, AccessMode access_mode, ShareMode share_mode) :
+	segment_path(std::move(segment_path)), segment_size(segment_size), access_mode(access_mode), share_mode(share_mode), size(0),
+	access_pattern(AccessPattern::Normal) {
+	if (segment_size == 0 || segment_size % sizeof(data_t) != 0) { throw std::invalid_argument("invalid segment size"); }
+	OpenExistingSegments();
+	UpdateSize();
+}
+
+SegmentedFile::~SegmentedFile() {}
+
+void SegmentedFile::SetSize(uint64 size) {
+	if (this->size == size) { return; }
+	uint count = size == 0 ? 0 : (uint)((size - 1) / segment_size + 1);
+	while (segment_list.size() > count) {
+		segment_list.pop_back(); std::filesystem::remove(segment_path((uint)segment_list.size()));
+	}
+	for (uint index = segment_list.empty() ? 0 : (uint)segment_list.size() - 1; index < count; ++index) {
+		if (index == segment_list.size()) { OpenSegment(FileManager::CreateMode::CreateAlways); }
+		uint64 segment_end = size - index * segment_size < segment_size ? size - index * segment_size : segment_size;
+		segment_list[index]->SetSize(segment_end);
+	}
+	this->size = size;
+}
+
+bool SegmentedFile::Refresh() {
+	uint64 old_size = size;
+	uint begin = segment_list.empty() ? 0 : (uint)segment_list.size() - 1;
+	OpenExistingSegments();
+	for (uint index = begin; index < segment_list.size(); ++index) { segment_list[index]->Refresh(); }
+	UpdateSize();
+	return size != old_size;
+}
+
+void SegmentedFile::OpenSegment(FileManager::CreateMode create_mode) {
+	std::wstring path = segment_path((uint)segment_list.size());
+	segment_list.emplace_back(new FileManager(path.c_str(), create_mode, access_mode, share_mode));
+	if (access_pattern != AccessPattern::Normal) { segment_list.back()->SetAccessPattern(access_pattern); }
+}
+
+void SegmentedFile::OpenExistingSegments() {
+	while (std::filesystem::exists(segment_path((uint)segment_list.size()))) { OpenSegment(FileManager::CreateMode::OpenExisting); }
+}
+
+void SegmentedFile::UpdateSize() {
+	size = 0;
+	for (uint index = 0; index < segment_list.size(); ++index) {
+		uint64 segment_end = segment_list[index]->GetSize();
+		if (segment_end > segment_size || (segment_end < segment_size && index + 1 < segment_list.size())) {
+			throw std::runtime_error("invalid segment size");
+		}
+		size += segment_end;
+	}
+}
+
+byte* SegmentedFile::Lock(uint64 offset, uint64 length) const {
+	uint64 index = offset / segment_size, segment_offset = offset % segment_size;
+	if (index >= segment_list.size()) { throw std::runtime_error("invalid offset or length"); }
+	if (segment_offset + length > segment_size) { throw std::runtime_error("block straddles segments"); }
+	return segment_list[index]->Lock(segment_offset, length);
+}
+
+void SegmentedFile::Unlock(uint64 offset, uint64 length, bool dirty) const {
+	segment_list[offset / segment_size]->Unlock(offset % segment_size, length, dirty);
+}
+
+void SegmentedFile::Flush() {
+	for (auto& segment : segment_list) { segment->Flush(); }
+}
+
+void SegmentedFile::SetAccessPattern(AccessPattern pattern) {
+	access_pattern = pattern;
+	for (auto& segment : segment_list) { segment->SetAccessPattern(pattern); }
+}
+
+void SegmentedFile::Advise(uint64 offset, uint64 length, AccessPattern pattern) const {
+	if (offset > size || length > size - offset) { throw std::runtime_error("invalid offset or length"); }
+	ForEachExtent(offset, length, [&](uint64 begin, uint64 extent) {
+		segment_list[begin / segment_size]->Advise(begin % segment_size, extent, pattern);
+	});
+}
+
+
+END_NAMESPACE(BlockStore)
\ No newline at end of file
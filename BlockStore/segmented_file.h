@@ -0,0 +1,61 @@
+#pragma once
+
+#include "file_manager.h"
+
+#include <memory>
+#include <vector>
+#include <string>
+#include <functional>
+
+
+BEGIN_NAMESPACE(BlockStore)
+
+
+class SegmentedFile : public BlockFile {
+public:
+	using path_function = std::function<std::wstring(uint index)>;
+	using AccessMode = FileManager::AccessMode;
+	using ShareMode = FileManager::ShareMode;
+public:
+	SegmentedFile(path_function segment_path,
+				  uint64 segment_size,
+				  AccessMode access_mode = AccessMode::ReadWrite,
+				  ShareMode share_mode = ShareMode::None);
+	virtual ~SegmentedFile() override;
+private:
+	path_function segment_path;
+	const uint64 segment_size;
+	AccessMode access_mode;
+	ShareMode share_mode;
+	uint64 size;
+public:
+	virtual bool IsReadOnly() const override { return access_mode == AccessMode::ReadOnly; }
+	virtual uint64 GetSize() const override { return size; }
+	virtual void SetSize(uint64 size) override;
+	virtual bool Refresh() override;
+
+	// segment
+private:
+	std::vector<std::unique_ptr<FileManager>> segment_list;
+private:
+	void OpenSegment(FileManager::CreateMode create_mode);
+	void OpenExistingSegments();
+	void UpdateSize();
+public:
+	uint GetSegmentCount() const { return (uint)segment_list.size(); }
+	virtual uint64 GetSegmentSize() const override { return segment_size; }
+	virtual byte* Lock(uint64 offset, uint64 length) const override;
+	virtual void Unlock(uint64 offset, uint64 length, bool dirty) const override;
+	virtual void Flush() override;
+
+	// access pattern
+private:
+	AccessPattern access_pattern;
+public:
+	virtual AccessPattern GetAccessPattern() const override { return access_pattern; }
+	virtual void SetAccessPattern(AccessPattern pattern) override;
+	virtual void Advise(uint64 offset, uint64 length, AccessPattern pattern) const override;
+};
+
+
+END_NAMESPACE(BlockStore)
\ No newline at end of file
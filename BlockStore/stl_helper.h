@@ -6,47 +6,68 @@
 #include <vector>
 #include <array>
 #include <variant>
+#include <optional>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <memory_resource>
 
 
 BEGIN_NAMESPACE(BlockStore)
 
 
-template<class T>
-struct layout_traits<std::basic_string<T>, std::enable_if_t<has_trivial_layout<T>>> {
-	static void Size(BlockSizeContext& context, const std::basic_string<T>& object) {
+// rebinds a pmr container to the arena of the block being loaded
+template<class Container>
+void bind_arena(BlockLoadContext& context, Container& object) {
+	using allocator = std::pmr::polymorphic_allocator<typename Container::value_type>;
+	if constexpr (std::is_same_v<typename Container::allocator_type, allocator>) {
+		std::pmr::memory_resource* resource = context.GetMemoryResource();
+		if (object.get_allocator().resource() != resource) { std::destroy_at(&object); ::new (&object) Container(allocator(resource)); }
+	}
+}
+
+
+template<class T, class Traits, class Alloc>
+struct layout_traits<std::basic_string<T, Traits, Alloc>, std::enable_if_t<has_trivial_layout<T>>> {
+	static void Size(BlockSizeContext& context, const std::basic_string<T, Traits, Alloc>& object) {
 		context.add(object.size()); context.add(object.data(), object.size());
 	}
-	static void Load(BlockLoadContext& context, std::basic_string<T>& object) {
+	static void Load(BlockLoadContext& context, std::basic_string<T, Traits, Alloc>& object) {
+		bind_arena(context, object);
 		data_t count; context.read(count); object.resize(count); context.read(object.data(), count);
 	}
-	static void Save(BlockSaveContext& context, const std::basic_string<T>& object) {
+	static void Save(BlockSaveContext& context, const std::basic_string<T, Traits, Alloc>& object) {
 		context.write(object.size()); context.write(object.data(), object.size());
 	}
 };
 
 
-template<class T>
-struct layout_traits<std::vector<T>, std::enable_if_t<has_trivial_layout<T>>> {
-	static void Size(BlockSizeContext& context, const std::vector<T>& object) {
+template<class T, class Alloc>
+struct layout_traits<std::vector<T, Alloc>, std::enable_if_t<has_trivial_layout<T>>> {
+	static void Size(BlockSizeContext& context, const std::vector<T, Alloc>& object) {
 		context.add(object.size()); context.add(object.data(), object.size());
 	}
-	static void Load(BlockLoadContext& context, std::vector<T>& object) {
+	static void Load(BlockLoadContext& context, std::vector<T, Alloc>& object) {
+		bind_arena(context, object);
 		data_t count; context.read(count); object.resize(count); context.read(object.data(), count);
 	}
-	static void Save(BlockSaveContext& context, const std::vector<T>& object) {
+	static void Save(BlockSaveContext& context, const std::vector<T, Alloc>& object) {
 		context.write(object.size()); context.write(object.data(), object.size());
 	}
 };
 
-template<class T>
-struct layout_traits<std::vector<T>, std::enable_if_t<!has_trivial_layout<T>>> {
-	static void Size(BlockSizeContext& context, const std::vector<T>& object) {
+template<class T, class Alloc>
+struct layout_traits<std::vector<T, Alloc>, std::enable_if_t<!has_trivial_layout<T>>> {
+	static void Size(BlockSizeContext& context, const std::vector<T, Alloc>& object) {
 		context.add(object.size());	for (auto& item : object) { BlockStore::Size(context, item); }
 	}
-	static void Load(BlockLoadContext& context, std::vector<T>& object) {
+	static void Load(BlockLoadContext& context, std::vector<T, Alloc>& object) {
+		bind_arena(context, object);
 		data_t count; context.read(count); object.resize(count); for (T& item : object) { BlockStore::Load(context, item); }
 	}
-	static void Save(BlockSaveContext& context, const std::vector<T>& object) {
+	static void Save(BlockSaveContext& context, const std::vector<T, Alloc>& object) {
 		context.write(object.size()); for (const T& item : object) { BlockStore::Save(context, item); }
 	}
 };
@@ -103,4 +124,152 @@ public:
 };
 
 
+template<class T>
+struct layout_traits<std::optional<T>> {
+	static void Size(BlockSizeContext& context, const std::optional<T>& object) {
+		context.add(object.has_value()); if (object) { BlockStore::Size(context, *object); }
+	}
+	static void Load(BlockLoadContext& context, std::optional<T>& object) {
+		bool has_value; context.read(has_value); if (has_value) { BlockStore::Load(context, object.emplace()); } else { object.reset(); }
+	}
+	static void Save(BlockSaveContext& context, const std::optional<T>& object) {
+		context.write(object.has_value()); if (object) { BlockStore::Save(context, *object); }
+	}
+};
+
+
+template<class K, class = void>
+struct key_column {
+	static_assert((layout_type<K>(), false), "searchable key must be trivial or a string");
+};
+
+template<class K>
+struct key_column<K, std::enable_if_t<has_trivial_layout<K>>> {
+	struct View {
+		const K* column;
+		data_t count;
+		const K& operator[](data_t index) const { return column[index]; }
+	};
+	static void Size(BlockSizeContext& context, const std::vector<const K*>& key_list) {
+		context.add<K>(nullptr, key_list.size());
+	}
+	static void Save(BlockSaveContext& context, const std::vector<const K*>& key_list) {
+		K* column = context.view<K>(key_list.size()); for (data_t index = 0; index < key_list.size(); ++index) { column[index] = *key_list[index]; }
+	}
+	static View Load(BlockLoadContext& context, data_t count) { return { context.view<K>(count), count }; }
+	static const K& Convert(const K& key) { return key; }
+};
+
+template<class T>
+struct key_column<std::basic_string<T>, std::enable_if_t<has_trivial_layout<T>>> {
+	struct View {
+		const data_t* offset;
+		const T* blob;
+		data_t count;
+		std::basic_string_view<T> operator[](data_t index) const { return { blob + offset[index], offset[index + 1] - offset[index] }; }
+	};
+	static void Size(BlockSizeContext& context, const std::vector<const std::basic_string<T>*>& key_list) {
+		data_t total = 0; for (auto key : key_list) { total += key->size(); }
+		context.add<data_t>(nullptr, key_list.size() + 1); context.add<T>(nullptr, total);
+	}
+	static void Save(BlockSaveContext& context, const std::vector<const std::basic_string<T>*>& key_list) {
+		data_t* offset = context.view<data_t>(key_list.size() + 1); offset[0] = 0;
+		for (data_t index = 0; index < key_list.size(); ++index) { offset[index + 1] = offset[index] + key_list[index]->size(); }
+		T* blob = context.view<T>(offset[key_list.size()]);
+		for (data_t index = 0; index < key_list.size(); ++index) { memcpy(blob + offset[index], key_list[index]->data(), key_list[index]->size() * sizeof(T)); }
+	}
+	static View Load(BlockLoadContext& context, data_t count) {
+		const data_t* offset = context.view<data_t>(count + 1); return { offset, context.view<T>(offset[count]), count };
+	}
+	static std::basic_string_view<T> Convert(const std::basic_string<T>& key) { return key; }
+};
+
+
+// encoded as the key count, a sorted key column, then for maps a value offset table followed by the values
+template<class Container, class K, class V>
+struct sorted_layout {
+private:
+	static constexpr bool is_map = !std::is_void_v<V>;
+	using item_type = typename Container::value_type;
+	static const K& get_key(const item_type& item) { if constexpr (is_map) { return item.first; } else { return item; } }
+	static std::vector<const item_type*> sort_items(const Container& object) {
+		std::vector<const item_type*> item_list; item_list.reserve(object.size());
+		for (auto& item : object) { item_list.push_back(&item); }
+		std::sort(item_list.begin(), item_list.end(), [](const item_type* a, const item_type* b) { return get_key(*a) < get_key(*b); });
+		return item_list;
+	}
+	static std::vector<const K*> key_list(const std::vector<const item_type*>& item_list) {
+		std::vector<const K*> key_list(item_list.size());
+		for (data_t index = 0; index < item_list.size(); ++index) { key_list[index] = &get_key(*item_list[index]); }
+		return key_list;
+	}
+	static data_t search(const typename key_column<K>::View& view, const K& key) {
+		auto target = key_column<K>::Convert(key);
+		data_t begin = 0, end = view.count;
+		while (begin < end) { data_t middle = begin + (end - begin) / 2; if (view[middle] < target) { begin = middle + 1; } else { end = middle; } }
+		return begin < view.count && !(target < view[begin]) ? begin : view.count;
+	}
+public:
+	static void Size(BlockSizeContext& context, const Container& object) {
+		auto item_list = sort_items(object);
+		context.add(item_list.size()); key_column<K>::Size(context, key_list(item_list));
+		if constexpr (is_map) {
+			context.add<data_t>(nullptr, item_list.size() + 1);
+			for (auto item : item_list) { BlockStore::Size(context, item->second); }
+		}
+	}
+	static void Load(BlockLoadContext& context, Container& object) {
+		data_t count; context.read(count); auto view = key_column<K>::Load(context, count);
+		object.clear();
+		if constexpr (is_map) {
+			context.view<data_t>(count + 1);
+			for (data_t index = 0; index < count; ++index) { BlockStore::Load(context, object[K(view[index])]); }
+		} else {
+			for (data_t index = 0; index < count; ++index) { object.emplace_hint(object.end(), view[index]); }
+		}
+	}
+	static void Save(BlockSaveContext& context, const Container& object) {
+		auto item_list = sort_items(object);
+		context.write(item_list.size()); key_column<K>::Save(context, key_list(item_list));
+		if constexpr (is_map) {
+			data_t* offset = context.view<data_t>(item_list.size() + 1); const byte* begin = context.view<byte>(0);
+			for (data_t index = 0; index < item_list.size(); ++index) {
+				offset[index] = context.view<byte>(0) - begin; BlockStore::Save(context, item_list[index]->second);
+			}
+			offset[item_list.size()] = context.view<byte>(0) - begin;
+		}
+	}
+public:
+	using find_result = std::conditional_t<is_map, std::optional<V>, bool>;
+	static find_result Find(const Container& object, const K& key) {
+		auto it = object.find(key);
+		if constexpr (is_map) { return it == object.end() ? find_result() : find_result(it->second); } else { return it != object.end(); }
+	}
+	static find_result Find(BlockLoadContext& context, const K& key) {
+		data_t count; context.read(count); auto view = key_column<K>::Load(context, count);
+		data_t index = search(view, key);
+		if constexpr (is_map) {
+			const data_t* offset = context.view<data_t>(count + 1); const byte* begin = context.view<byte>(0);
+			if (index == count) { return find_result(); }
+			BlockLoadContext value_context(context.GetBlockManager(), begin + offset[index], offset[index + 1] - offset[index]);
+			find_result value(std::in_place); BlockStore::Load(value_context, *value); return value;
+		} else {
+			return index != count;
+		}
+	}
+};
+
+template<class K, class V, class C, class A>
+struct layout_traits<std::map<K, V, C, A>> : sorted_layout<std::map<K, V, C, A>, K, V> {};
+
+template<class K, class C, class A>
+struct layout_traits<std::set<K, C, A>> : sorted_layout<std::set<K, C, A>, K, void> {};
+
+template<class K, class V, class H, class E, class A>
+struct layout_traits<std::unordered_map<K, V, H, E, A>> : sorted_layout<std::unordered_map<K, V, H, E, A>, K, V> {};
+
+template<class K, class H, class E, class A>
+struct layout_traits<std::unordered_set<K, H, E, A>> : sorted_layout<std::unordered_set<K, H, E, A>, K, void> {};
+
+
 END_NAMESPACE(BlockStore)
\ No newline at end of file
@@ -0,0 +1,88 @@
+#include "thread_pool.h"
+
+
+BEGIN_NAMESPACE(BlockStore)
+
+BEGIN_NAMESPACE(Anonymous)
+
+thread_local ref_ptr<ThreadPool> current_pool = nullptr;
+thread_local uint current_worker = 0;
+
+END_NAMESPACE(Anonymous)
+
+
+ThreadPool::ThreadPool(uint thread_count) : next_worker(0), task_count(0), stop(false) {
+	thread_count = thread_count > 0 ? thread_count : 1;
+	for (uint i = 0; i < thread_count; ++i) { worker_list.emplace_back(new Worker); }
+	for (uint i = 0; i < thread_count; ++i) { thread_list.emplace_back(&ThreadPool::Run, this, i); }
+}
+
+ThreadPool::~ThreadPool() {
+	{ std::lock_guard<std::mutex> lock(mutex); stop = true; }
+	condition.notify_all();
+	for (auto& thread : thread_list) { thread.join(); }
+}
+
+void ThreadPool::Push(std::function<void()> task) {
+	uint worker_index = current_pool == this ? current_worker : next_worker++ % (uint)worker_list.size();
+	Worker& worker = *worker_list[worker_index];
+	{ std::lock_guard<std::mutex> lock(mutex); ++task_count; }  // counted before it can be popped
+	{ std::lock_guard<std::mutex> lock(worker.mutex); worker.task_queue.push_back(std::move(task)); }
+	condition.notify_one();
+}
+
+bool ThreadPool::Pop(std::function<void()>& task) {
+	uint worker_count = (uint)worker_list.size();
+	uint first_worker = current_pool == this ? current_worker : next_worker % worker_count;
+	for (uint i = 0; i < worker_count; ++i) {
+		Worker& worker = *worker_list[(first_worker + i) % worker_count];
+		{
+			std::lock_guard<std::mutex> lock(worker.mutex);
+			if (worker.task_queue.empty()) { continue; }
+			if (i == 0 && current_pool == this) {
+				task = std::move(worker.task_queue.back()); worker.task_queue.pop_back();  // own queue, newest first
+			} else {
+				task = std::move(worker.task_queue.front()); worker.task_queue.pop_front();  // steal oldest
+			}
+		}
+		std::lock_guard<std::mutex> lock(mutex); --task_count; return true;
+	}
+	return false;
+}
+
+void ThreadPool::Run(uint worker_index) {
+	current_pool = this; current_worker = worker_index;
+	std::function<void()> task;
+	while (true) {
+		if (Pop(task)) { task(); task = nullptr; continue; }
+		std::unique_lock<std::mutex> lock(mutex);
+		condition.wait(lock, [&]() { return stop || task_count > 0; });
+		if (stop && task_count == 0) { return; }
+	}
+}
+
+void ThreadPool::Submit(TaskGroup& group, std::function<void()> task) {
+	++group.count;
+	Push([this, &group, task = std::move(task)]() {
+		try {
+			task();
+		} catch (...) {
+			std::lock_guard<std::mutex> lock(group.mutex);
+			if (group.exception == nullptr) { group.exception = std::current_exception(); }
+		}
+		if (--group.count == 0) { { std::lock_guard<std::mutex> lock(mutex); } condition.notify_all(); }  // the group may be gone once its count drops
+	});
+}
+
+void ThreadPool::Wait(TaskGroup& group) {
+	std::function<void()> task;
+	while (group.count > 0) {
+		if (Pop(task)) { task(); task = nullptr; continue; }
+		std::unique_lock<std::mutex> lock(mutex);
+		condition.wait(lock, [&]() { return group.count == 0 || task_count > 0; });  // woken to help with new tasks or when the group drains
+	}
+	if (group.exception != nullptr) { std::rethrow_exception(group.exception); }
+}
+
+
+END_NAMESPACE(BlockStore)
\ No newline at end of file
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "uncopyable.h"
+
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <atomic>
+#include <memory>
+
+
+BEGIN_NAMESPACE(BlockStore)
+
+
+class TaskGroup : Uncopyable {
+private:
+	std::atomic<data_t> count = 0;
+	std::mutex mutex;
+	std::exception_ptr exception;
+private:
+	friend class ThreadPool;
+};
+
+
+class ThreadPool : Uncopyable {
+public:
+	ThreadPool(uint thread_count = std::thread::hardware_concurrency());
+	~ThreadPool();
+
+	// worker
+private:
+	struct Worker {
+		std::mutex mutex;
+		std::deque<std::function<void()>> task_queue;
+	};
+	std::vector<std::unique_ptr<Worker>> worker_list;
+	std::vector<std::thread> thread_list;
+	std::atomic<uint> next_worker;
+private:
+	std::mutex mutex;
+	std::condition_variable condition;
+	data_t task_count;  // guarded by mutex
+	bool stop;
+private:
+	void Push(std::function<void()> task);
+	bool Pop(std::function<void()>& task);
+	void Run(uint worker_index);
+public:
+	uint GetThreadCount() const { return (uint)thread_list.size(); }
+
+	// task
+public:
+	void Submit(TaskGroup& group, std::function<void()> task);
+	void Wait(TaskGroup& group);
+public:
+	template<class Func>
+	void ParallelFor(data_t count, Func func) {
+		data_t chunk = count / ((data_t)GetThreadCount() * 4); chunk = chunk > 0 ? chunk : 1;
+		TaskGroup group;
+		for (data_t begin = 0; begin < count; begin += chunk) {
+			data_t end = begin + chunk < count ? begin + chunk : count;
+			Submit(group, [&func, begin, end]() { func(begin, end); });
+		}
+		Wait(group);
+	}
+};
+
+
+END_NAMESPACE(BlockStore)
\ No newline at end of file
@@ -0,0 +1,64 @@
+#include "BlockStore/file_manager.h"
+#include "BlockStore/block_manager.h"
+#include "BlockStore/stl_helper.h"
+
+#include <iostream>
+
+
+using namespace BlockStore;
+
+
+struct Document {
+	std::pmr::string title;
+	std::pmr::vector<std::pmr::string> line_list;
+	std::pmr::vector<double> score_list;
+};
+
+constexpr auto layout(layout_type<Document>) { return declare(&Document::title, &Document::line_list, &Document::score_list); }
+
+using RootRef = BlockRef<Document>;
+
+
+int main() {
+	std::unique_ptr<FileManager> file;
+	try {
+		file.reset(new FileManager(L"R:\\arena_test.dat", FileManager::CreateMode::CreateAlways));
+	} catch (std::runtime_error&) {
+		return 0;
+	}
+
+	constexpr uint line_count = 100;
+	{
+		BlockManager manager(std::move(file));
+		manager.Format();
+		RootRef root = manager;
+		{
+			auto document = root.Write();
+			document->title = "a document title that does not fit in a small string";
+			for (uint index = 0; index < line_count; ++index) {
+				document->line_list.emplace_back("line " + std::to_string(index) + " of a document stored in one block");
+				document->score_list.push_back(index * 0.5);
+			}
+		}
+		manager.SaveRootRef(root);
+	}
+
+	BlockManager manager(std::make_unique<FileManager>(L"R:\\arena_test.dat", FileManager::CreateMode::OpenExisting));
+	RootRef root; manager.LoadRootRef(root);
+	auto document = root.Read();
+	std::pmr::memory_resource* arena = document->title.get_allocator().resource();
+	uint arena_count = 0, mismatch_count = 0;
+	arena_count += arena != std::pmr::get_default_resource();
+	arena_count += document->line_list.get_allocator().resource() == arena;
+	arena_count += document->score_list.get_allocator().resource() == arena;
+	for (uint index = 0; index < line_count; ++index) {
+		arena_count += document->line_list[index].get_allocator().resource() == arena;
+		if (std::string_view(document->line_list[index]) != "line " + std::to_string(index) + " of a document stored in one block") { mismatch_count++; }
+		if (document->score_list[index] != index * 0.5) { mismatch_count++; }
+	}
+	std::cout << "arena members: " << arena_count << " / " << line_count + 3 << std::endl;
+	std::cout << "mismatches: " << mismatch_count << std::endl;
+
+	auto copy = root.Write();  // a writable copy leaves the arena of the cached block
+	std::cout << "copy in arena: " << (copy->title.get_allocator().resource() == arena) << std::endl;
+}
\ No newline at end of file
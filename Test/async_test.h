@@ -0,0 +1,83 @@
+#include "BlockStore/file_manager.h"
+#include "BlockStore/block_async.h"
+#include "BlockStore/stl_helper.h"
+
+#include <iostream>
+#include <atomic>
+#include <thread>
+
+
+using namespace BlockStore;
+
+
+struct TreeNode {
+	std::string text;
+	std::vector<BlockRef<TreeNode>> child_list;
+};
+
+constexpr auto layout(layout_type<TreeNode>) { return declare(&TreeNode::text, &TreeNode::child_list); }
+
+using RootRef = BlockRef<TreeNode>;
+
+
+struct Task {
+	struct promise_type {
+		Task get_return_object() { return {}; }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { std::terminate(); }
+	};
+};
+
+
+void Build(const RootRef& node_ref, uint depth) {
+	auto node = node_ref.Write(); node->text = "node " + std::to_string(depth);
+	for (uint index = 0; depth > 0 && index < 4; ++index) { node->child_list.emplace_back(node_ref.GetManager()); Build(node->child_list.back(), depth - 1); }
+}
+
+uint64 Count(const RootRef& node_ref) {
+	auto node = node_ref.Read(); uint64 count = node->text.size();
+	for (auto& child : node->child_list) { count += Count(child); }
+	return count;
+}
+
+Task Traverse(RootRef root, std::atomic<uint64>& total, std::atomic<uint>& done_count) {
+	std::vector<RootRef> stack(1, root); uint64 count = 0;
+	while (!stack.empty()) {
+		RootRef node_ref = std::move(stack.back()); stack.pop_back();
+		auto node = co_await node_ref.ReadAsync();
+		count += node->text.size(); stack.insert(stack.end(), node->child_list.begin(), node->child_list.end());
+	}
+	total += count; done_count++;
+}
+
+
+int main() {
+	std::unique_ptr<FileManager> file;
+	try {
+		file.reset(new FileManager(L"R:\\async_test.dat", FileManager::CreateMode::CreateAlways));
+	} catch (std::runtime_error&) {
+		return 0;
+	}
+
+	{
+		BlockManager manager(std::move(file));
+		manager.Format();
+		RootRef root = manager; Build(root, 7);
+		manager.SaveRootRef(root);
+	}
+
+	BlockManager manager(std::make_unique<FileManager>(L"R:\\async_test.dat", FileManager::CreateMode::OpenExisting));
+	manager.SetIOThreadCount(4);
+	RootRef root; manager.LoadRootRef(root);
+	std::vector<RootRef> task_list;
+	auto root_node = root.Read();
+	for (auto& child : root_node->child_list) { auto node = child.Read(); task_list.insert(task_list.end(), node->child_list.begin(), node->child_list.end()); }
+	std::atomic<uint64> total = 0; std::atomic<uint> done_count = 0;
+	for (auto& node_ref : task_list) { Traverse(node_ref, total, done_count); }
+	while (done_count < task_list.size()) { std::this_thread::yield(); }
+	uint64 expected = 0; for (auto& node_ref : task_list) { expected += Count(node_ref); }
+	std::cout << "traversals: " << task_list.size() << std::endl;
+	std::cout << "total matches: " << (total == expected) << std::endl;
+}
\ No newline at end of file
@@ -0,0 +1,67 @@
+#include "BlockStore/buffered_file.h"
+#include "BlockStore/block_manager.h"
+#include "BlockStore/stl_helper.h"
+
+#include <iostream>
+
+
+using namespace BlockStore;
+
+
+struct TreeNode {
+	std::string text;
+	std::vector<BlockRef<TreeNode>> child_list;
+};
+
+constexpr auto layout(layout_type<TreeNode>) { return declare(&TreeNode::text, &TreeNode::child_list); }
+
+using RootRef = BlockRef<TreeNode>;
+
+
+void BuildTree(RootRef& root, uint depth, uint& node_count) {
+	auto node = root.Write();
+	node->text = "node " + std::to_string(node_count++);
+	if (depth == 0) { return; }
+	node->child_list.resize(4);
+	for (auto& child_ref : node->child_list) {
+		child_ref = root.GetManager();
+		BuildTree(child_ref, depth - 1, node_count);
+	}
+}
+
+std::unique_ptr<BufferedFile> OpenFile(FileManager::CreateMode create_mode) {
+	constexpr uint64 page_size = 64 * 1024;
+	constexpr data_t page_count = 8;  // far smaller than the store
+	return std::make_unique<BufferedFile>(L"R:\\buffer_test.dat", page_size, page_count, create_mode);
+}
+
+
+int main() {
+	std::unique_ptr<BufferedFile> file;
+	try {
+		file = OpenFile(FileManager::CreateMode::CreateAlways);
+	} catch (std::runtime_error&) {
+		return 0;
+	}
+
+	uint node_count = 0;
+	{
+		BlockManager manager(std::move(file));
+		manager.Format();
+		RootRef root = manager;
+		BuildTree(root, 7, node_count);
+		root.Write()->text.assign(100 * 1024, 'r');  // larger than a page
+		manager.SaveRootRef(root);
+	}
+
+	BlockManager manager(OpenFile(FileManager::CreateMode::OpenExisting));
+	RootRef root; manager.LoadRootRef(root);
+	BlockCheckResult result = manager.Check(root);
+	std::cout << "saved blocks: " << node_count << std::endl;
+	std::cout << "reachable blocks: " << result.block_count << std::endl;
+	std::cout << "reachable bytes: " << result.reachable_size << " / " << result.total_size << std::endl;
+	std::cout << "root text bytes: " << root.Read()->text.size() << std::endl;
+	for (auto& [index, message] : result.error_list) {
+		std::cout << "error at " << index << ": " << message << std::endl;
+	}
+}
\ No newline at end of file
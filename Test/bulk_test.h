@@ -0,0 +1,53 @@
+#include "BlockStore/file_manager.h"
+#include "BlockStore/block_manager.h"
+#include "BlockStore/stl_helper.h"
+
+#include <iostream>
+
+
+using namespace BlockStore;
+
+
+struct TreeNode {
+	std::string text;
+	std::vector<BlockRef<TreeNode>> child_list;
+};
+
+constexpr auto layout(layout_type<TreeNode>) { return declare(&TreeNode::text, &TreeNode::child_list); }
+
+using RootRef = BlockRef<TreeNode>;
+
+
+RootRef LoadTree(BlockManager& manager, uint depth, uint& node_count) {
+	TreeNode node;
+	node.text = "node " + std::to_string(node_count++);
+	if (depth > 0) {
+		for (uint i = 0; i < 8; ++i) {
+			node.child_list.push_back(LoadTree(manager, depth - 1, node_count));
+		}
+	}
+	return manager.AppendBlock(node);
+}
+
+
+int main() {
+	std::unique_ptr<FileManager> file;
+	try {
+		file.reset(new FileManager(L"R:\\bulk_test.dat", FileManager::CreateMode::CreateAlways));
+	} catch (std::runtime_error&) {
+		return 0;
+	}
+
+	BlockManager manager(std::move(file));
+	manager.Format();
+	manager.BeginBulkLoad();
+	uint node_count = 0;
+	RootRef root = LoadTree(manager, 6, node_count);
+	manager.CommitBulkLoad(root);
+
+	BlockCheckResult result = manager.Check(root);
+	std::cout << "loaded blocks: " << node_count << std::endl;
+	std::cout << "reachable blocks: " << result.block_count << std::endl;
+	std::cout << "reachable bytes: " << result.reachable_size << " / " << result.total_size << std::endl;
+	std::cout << "root text: " << root.Read()->text << std::endl;
+}
\ No newline at end of file
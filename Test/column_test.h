@@ -0,0 +1,63 @@
+#include "BlockStore/file_manager.h"
+#include "BlockStore/block_manager.h"
+#include "BlockStore/column_vector.h"
+
+#include <iostream>
+
+
+using namespace BlockStore;
+
+
+struct Record {
+	uint64 id = 0;
+	std::string name;
+	std::vector<double> value_list;
+};
+
+constexpr auto layout(layout_type<Record>) { return declare(&Record::id, &Record::name, &Record::value_list); }
+
+struct Table {
+	column_vector<std::string> key_list;
+	column_vector<Record> record_list;
+};
+
+constexpr auto layout(layout_type<Table>) { return declare(&Table::key_list, &Table::record_list); }
+
+using RootRef = BlockRef<Table>;
+
+
+int main() {
+	std::unique_ptr<FileManager> file;
+	try {
+		file.reset(new FileManager(L"R:\\column_test.dat", FileManager::CreateMode::CreateAlways));
+	} catch (std::runtime_error&) {
+		return 0;
+	}
+
+	constexpr uint64 record_count = 1000;
+	{
+		BlockManager manager(std::move(file));
+		manager.Format();
+		RootRef root = manager;
+		{
+			auto table = root.Write();
+			for (uint64 id = 0; id < record_count; ++id) {
+				table->key_list.push_back("key " + std::to_string(id));
+				table->record_list.push_back({ id, std::string(id % 17, 'a'), std::vector<double>(id % 5, (double)id) });
+			}
+		}
+		manager.SaveRootRef(root);
+	}
+
+	BlockManager manager(std::make_unique<FileManager>(L"R:\\column_test.dat", FileManager::CreateMode::OpenExisting));
+	RootRef root; manager.LoadRootRef(root);
+	auto table = root.Read();
+	uint64 mismatch_count = table->key_list.size() == record_count && table->record_list.size() == record_count ? 0 : 1;
+	for (uint64 id = 0; mismatch_count == 0 && id < record_count; ++id) {
+		const Record& record = table->record_list[id];
+		if (table->key_list[id] != "key " + std::to_string(id)) { mismatch_count++; }
+		if (record.id != id || record.name != std::string(id % 17, 'a') || record.value_list != std::vector<double>(id % 5, (double)id)) { mismatch_count++; }
+	}
+	std::cout << "records: " << table->record_list.size() << std::endl;
+	std::cout << "mismatches: " << mismatch_count << std::endl;
+}
\ No newline at end of file
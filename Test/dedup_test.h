@@ -0,0 +1,93 @@
+#include "BlockStore/file_manager.h"
+#include "BlockStore/block_manager.h"
+#include "BlockStore/stl_helper.h"
+
+#include <iostream>
+
+
+using namespace BlockStore;
+
+
+struct TreeNode {
+	std::string text;
+	std::vector<BlockRef<TreeNode>> child_list;
+};
+
+constexpr auto layout(layout_type<TreeNode>) { return declare(&TreeNode::text, &TreeNode::child_list); }
+
+using RootRef = BlockRef<TreeNode>;
+
+struct Twin {
+	std::string text;
+	std::vector<BlockRef<TreeNode>> child_list;
+};
+
+constexpr auto layout(layout_type<Twin>) { return declare(&Twin::text, &Twin::child_list); }  // same encoding as TreeNode
+
+struct TwinPair {
+	RootRef node;
+	BlockRef<Twin> twin;
+};
+
+constexpr auto layout(layout_type<TwinPair>) { return declare(&TwinPair::node, &TwinPair::twin); }
+
+
+void BuildTree(RootRef& root, uint depth) {
+	auto node = root.Write();
+	node->text = "depth " + std::to_string(depth);  // identical subtrees at each depth
+	if (depth == 0) { return; }
+	node->child_list.resize(4);
+	for (auto& child_ref : node->child_list) {
+		child_ref = root.GetManager();
+		BuildTree(child_ref, depth - 1);
+	}
+}
+
+void CommitTree(const wchar path[], FileManager::CreateMode mode, bool dedup) {
+	BlockManager manager(std::make_unique<FileManager>(path, mode));
+	if (mode == FileManager::CreateMode::CreateAlways) { manager.Format(); }
+	manager.EnableDedup(dedup);
+	RootRef root = manager;
+	BuildTree(root, 5);
+	root.Write()->child_list.push_back(root);  // cycle back to the root
+	manager.SaveRootRef(root);
+
+	BlockCheckResult result = manager.Check(root);
+	std::cout << "reachable blocks: " << result.block_count << ", file bytes: " << result.total_size << std::endl;
+	for (auto& [index, message] : result.error_list) {
+		std::cout << "error at " << index << ": " << message << std::endl;
+	}
+}
+
+void CommitTwins(const wchar path[]) {
+	BlockManager manager(std::make_unique<FileManager>(path, FileManager::CreateMode::CreateAlways));
+	manager.Format();
+	manager.EnableDedup(true);
+	BlockRef<TwinPair> root = manager;
+	{
+		auto pair = root.Write(); pair->node = manager; pair->twin = manager;
+		pair->node.Write()->text = "twin"; pair->twin.Write()->text = "twin";
+	}
+	manager.SaveRootRef(root);
+
+	auto pair = root.Read(); auto node = pair->node.Read(); auto twin = pair->twin.Read();
+	std::cout << "twins read back: " << (node->text == twin->text) << std::endl;
+}
+
+
+int main() {
+	try {
+		FileManager(L"R:\\dedup_test.dat", FileManager::CreateMode::CreateAlways);
+	} catch (std::runtime_error&) {
+		return 0;
+	}
+
+	std::cout << "plain commit" << std::endl;
+	CommitTree(L"R:\\dedup_test.dat", FileManager::CreateMode::CreateAlways, false);
+	std::cout << "dedup commit" << std::endl;
+	CommitTree(L"R:\\dedup_test.dat", FileManager::CreateMode::CreateAlways, true);
+	std::cout << "dedup commit after reopen" << std::endl;
+	CommitTree(L"R:\\dedup_test.dat", FileManager::CreateMode::OpenExisting, true);
+	std::cout << "dedup commit of equal blocks of two types" << std::endl;
+	CommitTwins(L"R:\\dedup_test.dat");
+}
\ No newline at end of file
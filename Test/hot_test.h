@@ -0,0 +1,108 @@
+#include "BlockStore/file_manager.h"
+#include "BlockStore/block_manager.h"
+#include "BlockStore/stl_helper.h"
+
+#include <iostream>
+
+
+using namespace BlockStore;
+
+
+struct Leaf {
+	uint64 id;
+	std::string text;
+};
+
+constexpr auto layout(layout_type<Leaf>) { return declare(&Leaf::id, &Leaf::text); }
+
+struct Table {
+	std::vector<BlockRef<Leaf>> leaf_list;
+};
+
+constexpr auto layout(layout_type<Table>) { return declare(&Table::leaf_list); }
+
+using RootRef = BlockRef<Table>;
+
+struct OtherLeaf {
+	uint64 id;
+	std::string text;
+};
+
+constexpr auto layout(layout_type<OtherLeaf>) { return declare(&OtherLeaf::id, &OtherLeaf::text); }
+
+struct OtherTable {
+	std::vector<BlockRef<OtherLeaf>> leaf_list;
+};
+
+constexpr auto layout(layout_type<OtherTable>) { return declare(&OtherTable::leaf_list); }
+
+
+int main() {
+	const wchar path[] = L"R:\\hot_test.dat", hot_set_path[] = L"R:\\hot_test.hot";
+	std::unique_ptr<FileManager> file;
+	try {
+		file.reset(new FileManager(path, FileManager::CreateMode::CreateAlways));
+	} catch (std::runtime_error&) {
+		return 0;
+	}
+
+	constexpr uint64 leaf_count = 10000, hot_count = 100;
+	{
+		BlockManager manager(std::move(file));
+		manager.Format();
+		RootRef root = manager;
+		{
+			auto table = root.Write(); table->leaf_list.resize(leaf_count);
+			for (uint64 id = 0; id < leaf_count; ++id) { table->leaf_list[id] = manager; *table->leaf_list[id].Write() = { id, "leaf " + std::to_string(id) }; }
+		}
+		manager.SaveRootRef(root);
+	}
+
+	{
+		BlockManager manager(std::make_unique<FileManager>(path, FileManager::CreateMode::OpenExisting));
+		manager.SetHotSet(hot_set_path, hot_count);
+		RootRef root; manager.LoadRootRef(root);
+		auto table = root.Read();
+		for (uint round = 0; round < 3; ++round) {
+			for (uint64 id = 0; id < leaf_count; id += round == 0 ? 1 : leaf_count / hot_count) { table->leaf_list[id].Read(); }
+		}
+	}  // the hot set is saved on close
+
+	{
+		BlockManager manager(std::make_unique<FileManager>(path, FileManager::CreateMode::OpenExisting));
+		manager.SetHotSet(hot_set_path, hot_count);
+		manager.WarmHotSet<Table>(true);
+		std::cout << "prefetched only: " << (manager.GetWarmSize() == 0) << std::endl;
+		manager.WarmHotSet<Leaf>(true);
+		std::cout << "warmed blocks: " << manager.GetWarmSize() << " / " << hot_count << std::endl;
+		RootRef root; manager.LoadRootRef(root);
+		auto table = root.Read();
+		uint mismatch_count = 0;
+		for (uint64 id = 0; id < leaf_count; id += leaf_count / hot_count) {
+			auto leaf = table->leaf_list[id].Read();
+			if (leaf->id != id || leaf->text != "leaf " + std::to_string(id)) { mismatch_count++; }
+		}
+		manager.ReleaseWarmSet();
+		std::cout << "mismatches: " << mismatch_count << std::endl;
+	}
+
+	{
+		BlockManager manager(std::make_unique<FileManager>(path, FileManager::CreateMode::OpenExisting));
+		manager.SetHotSet(hot_set_path, hot_count);
+		manager.WarmHotSet<Leaf>(true);
+		BlockRef<OtherTable> root; manager.LoadRootRef(root);
+		auto table = root.Read();
+		uint read_count = 0;
+		for (uint64 id = 0; id < leaf_count; id += leaf_count / hot_count) { read_count += table->leaf_list[id].Read()->id == id; }
+		std::cout << "read as another type: " << read_count << " / " << hot_count << ", still warm: " << manager.GetWarmSize() << std::endl;
+		manager.ReleaseWarmSet();
+	}
+
+	BlockManager manager(std::make_unique<FileManager>(path, FileManager::CreateMode::CreateAlways));
+	manager.Format();
+	RootRef root = manager; root.Write()->leaf_list.resize(1, manager);
+	manager.SaveRootRef(root);
+	manager.SetHotSet(hot_set_path, hot_count);
+	manager.WarmHotSet<Leaf>(true);
+	std::cout << "warmed after reformat: " << manager.GetWarmSize() << std::endl;
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+#include "BlockStore/file_manager.h"
+#include "BlockStore/block_manager.h"
+#include "BlockStore/stl_helper.h"
+
+#include <iostream>
+#include <filesystem>
+
+
+using namespace BlockStore;
+
+
+struct Node {
+	uint64 value = 0;
+	std::string text;
+	std::vector<LogicalRef<Node>> child_list;
+};
+
+constexpr auto layout(layout_type<Node>) { return declare(&Node::value, &Node::text, &Node::child_list); }
+
+using RootRef = BlockRef<Node>;
+
+
+int main() {
+	const wchar path[] = L"R:\\logical_test.dat";
+	std::unique_ptr<FileManager> file;
+	try {
+		file.reset(new FileManager(path, FileManager::CreateMode::CreateAlways));
+	} catch (std::runtime_error&) {
+		return 0;
+	}
+
+	constexpr uint depth = 1000, update_count = 100;
+	std::vector<LogicalRef<Node>> path_list;
+	{
+		BlockManager manager(std::move(file));
+		manager.Format();
+		RootRef root = manager;
+		root.Write()->text = "root";
+		LogicalRef<Node> parent; root.Write()->child_list.push_back(parent = manager);
+		for (uint level = 0; level < depth; ++level) {
+			auto node = parent.Write(); node->value = level; node->text = "node " + std::to_string(level);
+			if (level + 1 < depth) { node->child_list.push_back(parent = manager); }
+		}
+		manager.SaveRootRef(root);
+	}
+
+	uint64 committed_size = std::filesystem::file_size(path);
+	{
+		BlockManager manager(std::make_unique<FileManager>(path, FileManager::CreateMode::OpenExisting));
+		RootRef root; manager.LoadRootRef(root);
+		LogicalRef<Node> leaf = root.Read()->child_list[0];
+		while (!leaf.Read()->child_list.empty()) { leaf = leaf.Read()->child_list[0]; }
+		for (uint step = 0; step < update_count; ++step) {
+			leaf.Write()->value += 1;
+			manager.SaveRootRef(root);
+		}
+	}
+	std::cout << "bytes per leaf update: " << (std::filesystem::file_size(path) - committed_size) / update_count << std::endl;
+
+	BlockManager manager(std::make_unique<FileManager>(path, FileManager::CreateMode::OpenExisting));
+	RootRef root; manager.LoadRootRef(root);
+	uint level = 0, mismatch_count = 0;
+	for (LogicalRef<Node> node = root.Read()->child_list[0];; ++level) {
+		auto block = node.Read();
+		if (block->value != (level + 1 < depth ? level : level + update_count) || block->text != "node " + std::to_string(level)) { mismatch_count++; }
+		if (block->child_list.empty()) { break; }
+		node = block->child_list[0];
+	}
+	std::cout << "depth: " << level + 1 << std::endl;
+	std::cout << "mismatches: " << mismatch_count << std::endl;
+	BlockCheckResult result = manager.Check(root);
+	std::cout << "reachable blocks: " << result.block_count << std::endl;
+	std::cout << "errors: " << result.error_list.size() << std::endl;
+}
\ No newline at end of file
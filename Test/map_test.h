@@ -0,0 +1,80 @@
+#include "BlockStore/file_manager.h"
+#include "BlockStore/block_manager.h"
+#include "BlockStore/stl_helper.h"
+
+#include <iostream>
+
+
+using namespace BlockStore;
+
+
+struct Record {
+	uint64 id = 0;
+	std::string name;
+	std::optional<std::vector<double>> value_list;
+};
+
+constexpr auto layout(layout_type<Record>) { return declare(&Record::id, &Record::name, &Record::value_list); }
+
+using RecordMap = std::map<std::string, Record>;
+using IdMap = std::unordered_map<uint64, std::string>;
+using TagSet = std::set<std::string>;
+
+struct Index {
+	BlockRef<RecordMap> record_map;
+	BlockRef<IdMap> id_map;
+	BlockRef<TagSet> tag_set;
+};
+
+constexpr auto layout(layout_type<Index>) { return declare(&Index::record_map, &Index::id_map, &Index::tag_set); }
+
+using RootRef = BlockRef<Index>;
+
+
+std::string MakeKey(uint64 id) { return "key " + std::to_string(id * 7919 % 100003); }
+
+
+int main() {
+	std::unique_ptr<FileManager> file;
+	try {
+		file.reset(new FileManager(L"R:\\map_test.dat", FileManager::CreateMode::CreateAlways));
+	} catch (std::runtime_error&) {
+		return 0;
+	}
+
+	constexpr uint64 record_count = 10000;
+	{
+		BlockManager manager(std::move(file));
+		manager.Format();
+		RootRef root = manager;
+		{
+			auto index = root.Write();
+			index->record_map = manager; index->id_map = manager; index->tag_set = manager;
+			auto record_map = index->record_map.Write(); auto id_map = index->id_map.Write(); auto tag_set = index->tag_set.Write();
+			for (uint64 id = 0; id < record_count; ++id) {
+				Record& record = (*record_map)[MakeKey(id)]; record.id = id; record.name = "record " + std::to_string(id);
+				if (id % 3 == 0) { record.value_list.emplace(id % 7, (double)id); }
+				(*id_map)[id] = MakeKey(id);
+				if (id % 10 == 0) { tag_set->insert("tag " + std::to_string(id)); }
+			}
+		}
+		manager.SaveRootRef(root);
+	}
+
+	BlockManager manager(std::make_unique<FileManager>(L"R:\\map_test.dat", FileManager::CreateMode::OpenExisting));
+	RootRef root; manager.LoadRootRef(root);
+	auto index = root.Read();
+	uint64 mismatch_count = 0;
+	for (uint64 id = 0; id < record_count; id += 7) {
+		std::optional<Record> record = index->record_map.Find(MakeKey(id));
+		if (!record || record->id != id || record->name != "record " + std::to_string(id)) { mismatch_count++; continue; }
+		if (record->value_list.has_value() != (id % 3 == 0) || (record->value_list && record->value_list->size() != id % 7)) { mismatch_count++; }
+		if (index->id_map.Find(id) != MakeKey(id)) { mismatch_count++; }
+		if (index->tag_set.Find("tag " + std::to_string(id)) != (id % 10 == 0)) { mismatch_count++; }
+	}
+	if (index->record_map.Find(std::string("missing")) || index->id_map.Find(record_count)) { mismatch_count++; }
+	if (index->record_map.Read()->size() != record_count || index->id_map.Read()->size() != record_count) { mismatch_count++; }
+	if (index->record_map.Find(MakeKey(1))->id != 1) { mismatch_count++; }  // served from the cache after Read
+	std::cout << "records: " << record_count << std::endl;
+	std::cout << "mismatches: " << mismatch_count << std::endl;
+}
\ No newline at end of file
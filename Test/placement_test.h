@@ -0,0 +1,85 @@
+#include "BlockStore/file_manager.h"
+#include "BlockStore/block_manager.h"
+#include "BlockStore/stl_helper.h"
+
+#include <iostream>
+#include <fstream>
+
+
+using namespace BlockStore;
+
+
+struct Node {
+	uint64 id = 0;
+	std::vector<BlockRef<Node>> child_list;
+};
+
+constexpr auto layout(layout_type<Node>) { return declare(&Node::id, &Node::child_list); }
+
+using RootRef = BlockRef<Node>;
+
+
+constexpr uint64 fanout = 4, depth = 5, cluster_size = 2;
+
+std::vector<std::vector<uint64>> child_map;
+
+RootRef Build(BlockManager& manager, uint64 level) {
+	RootRef node_ref = manager; auto node = node_ref.Write();
+	node->id = child_map.size(); child_map.emplace_back();
+	for (uint64 index = 0; level + 1 < depth && index < fanout; ++index) {
+		node->child_list.push_back(Build(manager, level + 1)); child_map[node->id].push_back(node->child_list.back().Read()->id);
+	}
+	return node_ref;
+}
+
+void VisitClustered(uint64 id, std::vector<uint64>& order) {
+	const std::vector<uint64>& child_list = child_map[id];
+	for (uint64 index = 0; index < child_list.size() && index < cluster_size; ++index) { order.push_back(child_list[index]); }
+	for (uint64 index = 0; index < child_list.size(); ++index) {
+		if (index >= cluster_size) { order.push_back(child_list[index]); }
+		VisitClustered(child_list[index], order);
+	}
+}
+
+std::vector<uint64> ExpectedOrder(PlacementPolicy policy) {
+	std::vector<uint64> order(1, 0);
+	if (policy == PlacementPolicy::DepthFirst) {
+		for (uint64 id = 1; id < child_map.size(); ++id) { order.push_back(id); }  // built in pre-order
+	} else if (policy == PlacementPolicy::BreadthFirst) {
+		for (uint64 index = 0; index < order.size(); ++index) { order.insert(order.end(), child_map[order[index]].begin(), child_map[order[index]].end()); }
+	} else {
+		VisitClustered(0, order);
+	}
+	return order;
+}
+
+std::vector<uint64> FileOrder(const char* path) {
+	std::ifstream file(path, std::ios::binary); std::vector<uint64> order;
+	file.seekg(meta_info_size);
+	for (data_t length; file.read((char*)&length, sizeof(data_t));) {
+		uint64 id; file.read((char*)&id, sizeof(uint64)); order.push_back(id);
+		file.seekg(length - sizeof(uint64), std::ios::cur);
+	}
+	return order;
+}
+
+
+int main() {
+	const char* policy_name[] = { "depth first", "breadth first", "clustered" };
+	for (PlacementPolicy policy : { PlacementPolicy::DepthFirst, PlacementPolicy::BreadthFirst, PlacementPolicy::Clustered }) {
+		std::unique_ptr<FileManager> file;
+		try {
+			file.reset(new FileManager(L"R:\\placement_test.dat", FileManager::CreateMode::CreateAlways));
+		} catch (std::runtime_error&) {
+			return 0;
+		}
+		{
+			BlockManager manager(std::move(file));
+			manager.Format();
+			manager.SetPlacementPolicy(policy, cluster_size);
+			child_map.clear(); RootRef root = Build(manager, 0);
+			manager.SaveRootRef(root);
+		}
+		std::cout << policy_name[(int)policy] << " order matches: " << (FileOrder("R:\\placement_test.dat") == ExpectedOrder(policy)) << std::endl;
+	}
+}
\ No newline at end of file
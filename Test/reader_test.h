@@ -0,0 +1,60 @@
+#include "BlockStore/file_manager.h"
+#include "BlockStore/block_manager.h"
+#include "BlockStore/stl_helper.h"
+
+#include <iostream>
+
+
+using namespace BlockStore;
+
+
+struct Version {
+	uint number;
+	std::string text;
+};
+
+constexpr auto layout(layout_type<Version>) { return declare(&Version::number, &Version::text); }
+
+using RootRef = BlockRef<Version>;
+
+
+void Commit(BlockManager& writer, uint number) {
+	RootRef root = writer;
+	auto version = root.Write();
+	version->number = number;
+	version->text = "version " + std::to_string(number);
+	writer.SaveRootRef(root);
+}
+
+
+int main() {
+	std::unique_ptr<FileManager> writer_file, reader_file;
+	try {
+		writer_file.reset(new FileManager(L"R:\\reader_test.dat", FileManager::CreateMode::CreateAlways,
+										  FileManager::AccessMode::ReadWrite, FileManager::ShareMode::ReadWrite));
+		reader_file.reset(new FileManager(L"R:\\reader_test.dat", FileManager::CreateMode::OpenExisting,
+										  FileManager::AccessMode::ReadOnly, FileManager::ShareMode::ReadWrite));
+	} catch (std::runtime_error&) {
+		return 0;
+	}
+
+	BlockManager writer(std::move(writer_file));
+	BlockManager reader(std::move(reader_file));
+	writer.Format();
+
+	RootRef root;
+	for (uint number = 1; number <= 3; ++number) {
+		Commit(writer, number);
+		if (reader.Refresh()) {
+			reader.LoadRootRef(root);
+			std::cout << "reader sees " << root.Read()->text << std::endl;
+		}
+		std::cout << "refresh again: " << reader.Refresh() << std::endl;
+	}
+
+	try {
+		root.Write();
+	} catch (std::runtime_error& error) {
+		std::cout << "write rejected: " << error.what() << std::endl;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,77 @@
+#include "BlockStore/file_manager.h"
+#include "BlockStore/block_manager.h"
+#include "BlockStore/stl_helper.h"
+
+#include <iostream>
+#include <filesystem>
+
+
+using namespace BlockStore;
+
+
+struct Entry {
+	uint number;
+	std::string text;
+	BlockRef<Entry> next;
+};
+
+constexpr auto layout(layout_type<Entry>) { return declare(&Entry::number, &Entry::text, &Entry::next); }
+
+using RootRef = BlockRef<Entry>;
+
+
+void Append(BlockManager& manager, RootRef& root, uint number) {
+	RootRef entry = manager;
+	auto node = entry.Write();
+	node->number = number;
+	node->text = "entry " + std::to_string(number);
+	node->next = root;
+	root = std::move(entry);
+}
+
+void PrintList(RootRef root) {
+	while (true) {
+		auto node = root.Read();
+		std::cout << node->text << std::endl;
+		if (node->number == 0) { break; }
+		root = node->next;
+	}
+}
+
+
+int main() {
+	const wchar change_log[] = L"R:\\replica_log";
+	std::unique_ptr<FileManager> primary_file, replica_file;
+	try {
+		std::filesystem::remove_all(change_log);
+		std::filesystem::create_directories(change_log);
+		primary_file.reset(new FileManager(L"R:\\replica_primary.dat", FileManager::CreateMode::CreateAlways));
+		replica_file.reset(new FileManager(L"R:\\replica_backup.dat", FileManager::CreateMode::CreateAlways));
+	} catch (std::exception&) {
+		return 0;
+	}
+
+	BlockManager primary(std::move(primary_file));
+	BlockManager replica(std::move(replica_file));
+	primary.Format();
+	replica.Format();
+	primary.SetChangeLog(change_log);
+
+	RootRef root = primary;
+	{
+		auto first = root.Write();
+		first->number = 0;
+		first->text = "entry 0";
+		first->next = root;
+	}
+	primary.SaveRootRef(root);
+	for (uint number = 1; number <= 3; ++number) { Append(primary, root, number); primary.SaveRootRef(root); }
+	std::cout << "applied segments: " << replica.ApplyChangeLog(change_log) << std::endl;
+
+	for (uint number = 4; number <= 5; ++number) { Append(primary, root, number); primary.SaveRootRef(root); }
+	std::cout << "applied segments: " << replica.ApplyChangeLog(change_log) << std::endl;
+	std::cout << "applied segments: " << replica.ApplyChangeLog(change_log) << std::endl;
+
+	RootRef replica_root; replica.LoadRootRef(replica_root);
+	PrintList(replica_root);
+}
\ No newline at end of file
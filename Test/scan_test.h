@@ -0,0 +1,59 @@
+#include "BlockStore/file_manager.h"
+#include "BlockStore/block_manager.h"
+#include "BlockStore/stl_helper.h"
+
+#include <iostream>
+#include <atomic>
+
+
+using namespace BlockStore;
+
+
+struct TreeNode {
+	std::string text;
+	std::vector<BlockRef<TreeNode>> child_list;
+};
+
+constexpr auto layout(layout_type<TreeNode>) { return declare(&TreeNode::text, &TreeNode::child_list); }
+
+using RootRef = BlockRef<TreeNode>;
+
+
+void BuildTree(RootRef& root, uint depth) {
+	auto node = root.Write();
+	node->text = "depth " + std::to_string(depth);
+	if (depth == 0) { return; }
+	node->child_list.resize(4);
+	for (auto& child_ref : node->child_list) {
+		child_ref = root.GetManager();
+		BuildTree(child_ref, depth - 1);
+	}
+	node->child_list.push_back(node->child_list.front());  // shared child
+}
+
+
+int main() {
+	std::unique_ptr<FileManager> file;
+	try {
+		file.reset(new FileManager(L"R:\\scan_test.dat", FileManager::CreateMode::CreateAlways));
+	} catch (std::runtime_error&) {
+		return 0;
+	}
+
+	BlockManager manager(std::move(file));
+	manager.Format();
+	RootRef root = manager;
+	BuildTree(root, 6);
+	manager.SaveRootRef(root);
+
+	std::atomic<data_t> block_count = 0;
+	manager.Scan(root, [&](data_t index, data_t length) { block_count++; }, BlockFile::AccessPattern::Sequential);
+	std::cout << "scanned blocks: " << block_count << std::endl;
+
+	BlockCheckResult result = manager.Check(root);
+	std::cout << "reachable blocks: " << result.block_count << std::endl;
+	std::cout << "reachable bytes: " << result.reachable_size << " / " << result.total_size << std::endl;
+	for (auto& [index, message] : result.error_list) {
+		std::cout << "error at " << index << ": " << message << std::endl;
+	}
+}
\ No newline at end of file
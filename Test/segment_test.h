@@ -0,0 +1,66 @@
+#include "BlockStore/segmented_file.h"
+#include "BlockStore/block_manager.h"
+#include "BlockStore/stl_helper.h"
+
+#include <iostream>
+
+
+using namespace BlockStore;
+
+
+struct TreeNode {
+	std::string text;
+	std::vector<BlockRef<TreeNode>> child_list;
+};
+
+constexpr auto layout(layout_type<TreeNode>) { return declare(&TreeNode::text, &TreeNode::child_list); }
+
+using RootRef = BlockRef<TreeNode>;
+
+
+void BuildTree(RootRef& root, uint depth) {
+	auto node = root.Write();
+	node->text = "depth " + std::to_string(depth) + std::string(100, '.');
+	if (depth == 0) { return; }
+	node->child_list.resize(4);
+	for (auto& child_ref : node->child_list) {
+		child_ref = root.GetManager();
+		BuildTree(child_ref, depth - 1);
+	}
+}
+
+std::unique_ptr<SegmentedFile> OpenSegments() {
+	constexpr uint64 segment_size = 64 * 1024;
+	return std::make_unique<SegmentedFile>([](uint index) { return L"R:\\segment_test_" + std::to_wstring(index) + L".dat"; }, segment_size);
+}
+
+
+int main() {
+	try {
+		OpenSegments();
+	} catch (std::runtime_error&) {
+		return 0;
+	}
+
+	{
+		BlockManager manager(OpenSegments());
+		manager.Format();
+		RootRef root = manager;
+		BuildTree(root, 6);
+		manager.SaveRootRef(root);
+	}
+
+	std::unique_ptr<SegmentedFile> file = OpenSegments(); SegmentedFile& segments = *file;
+	BlockManager manager(std::move(file));
+	RootRef root; manager.LoadRootRef(root);
+	BlockCheckResult result = manager.Check(root);
+	std::cout << "segments: " << segments.GetSegmentCount() << std::endl;
+	std::cout << "reachable blocks: " << result.block_count << std::endl;
+	std::cout << "reachable bytes: " << result.reachable_size << " / " << result.total_size << std::endl;
+	for (auto& [index, message] : result.error_list) {
+		std::cout << "error at " << index << ": " << message << std::endl;
+	}
+
+	manager.Format();
+	std::cout << "segments after format: " << segments.GetSegmentCount() << std::endl;
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+#include "BlockStore/file_manager.h"
+#include "BlockStore/block_manager.h"
+#include "BlockStore/stl_helper.h"
+
+#include <iostream>
+
+
+using namespace BlockStore;
+
+
+struct TreeNode {
+	std::string text;
+	std::vector<BlockRef<TreeNode>> child_list;
+};
+
+constexpr auto layout(layout_type<TreeNode>) { return declare(&TreeNode::text, &TreeNode::child_list); }
+
+using RootRef = BlockRef<TreeNode>;
+
+
+void BuildTree(RootRef& root, uint depth, uint& node_count) {
+	auto node = root.Write();
+	node->text = "node " + std::to_string(node_count++);
+	if (depth == 0) { return; }
+	node->child_list.resize(4);
+	for (auto& child_ref : node->child_list) {
+		child_ref = root.GetManager();
+		BuildTree(child_ref, depth - 1, node_count);
+	}
+}
+
+uint VerifyTree(const RootRef& root, uint& node_count) {
+	auto node = root.Read(); uint mismatch_count = node->text != "node " + std::to_string(node_count++);
+	for (auto& child_ref : node->child_list) { mismatch_count += VerifyTree(child_ref, node_count); }
+	return mismatch_count;
+}
+
+
+int main() {
+	std::unique_ptr<FileManager> file;
+	try {
+		file.reset(new FileManager(L"R:\\spill_test.dat", FileManager::CreateMode::CreateAlways));
+	} catch (std::runtime_error&) {
+		return 0;
+	}
+
+	uint node_count = 0;
+	{
+		BlockManager manager(std::move(file));
+		manager.Format();
+		manager.SetMemoryBudget(1024 * 1024);
+		RootRef root = manager;
+		BuildTree(root, 8, node_count);
+		std::cout << "spilled bytes before commit: " << manager.GetSpilledSize() << std::endl;
+		manager.SaveRootRef(root);
+	}
+
+	BlockManager manager(std::make_unique<FileManager>(L"R:\\spill_test.dat", FileManager::CreateMode::OpenExisting));
+	RootRef root; manager.LoadRootRef(root);
+	BlockCheckResult result = manager.Check(root);
+	uint verify_count = 0, mismatch_count = VerifyTree(root, verify_count);
+	std::cout << "saved blocks: " << node_count << std::endl;
+	std::cout << "reachable blocks: " << result.block_count << std::endl;
+	std::cout << "reachable bytes: " << result.reachable_size << " / " << result.total_size << std::endl;
+	std::cout << "mismatches: " << mismatch_count << std::endl;
+	for (auto& [index, message] : result.error_list) {
+		std::cout << "error at " << index << ": " << message << std::endl;
+	}
+}
@@ -1,6 +1,23 @@
 //#include "tree_test.h"
 //#include "ring_test.h"
 #include "list_test.h"
+//#include "scan_test.h"
+//#include "bulk_test.h"
+//#include "reader_test.h"
+//#include "replica_test.h"
+//#include "dedup_test.h"
+//#include "segment_test.h"
+//#include "buffer_test.h"
+//#include "column_test.h"
+//#include "map_test.h"
+//#include "arena_test.h"
+//#include "spill_test.h"
+//#include "update_test.h"
+//#include "logical_test.h"
+//#include "placement_test.h"
+//#include "async_test.h"
+//#include "writer_test.h"
+//#include "hot_test.h"
 
 
 #pragma comment(lib, "BlockStore.lib")
\ No newline at end of file
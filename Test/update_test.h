@@ -0,0 +1,85 @@
+#include "BlockStore/file_manager.h"
+#include "BlockStore/block_manager.h"
+#include "BlockStore/stl_helper.h"
+
+#include <iostream>
+#include <filesystem>
+
+
+using namespace BlockStore;
+
+
+struct Counter {
+	uint64 hits;
+	double total;
+};
+
+struct Stat {
+	uint id;
+	Counter counter;
+};
+
+constexpr auto layout(layout_type<Stat>) { return declare(&Stat::id, &Stat::counter); }
+
+struct StatList {
+	std::vector<BlockRef<Stat>> stat_list;
+};
+
+constexpr auto layout(layout_type<StatList>) { return declare(&StatList::stat_list); }
+
+using RootRef = BlockRef<StatList>;
+
+
+int main() {
+	const wchar path[] = L"R:\\update_test.dat", log_path[] = L"R:\\update_test.log";
+	std::unique_ptr<FileManager> file;
+	try {
+		file.reset(new FileManager(path, FileManager::CreateMode::CreateAlways));
+	} catch (std::runtime_error&) {
+		return 0;
+	}
+	std::filesystem::remove(log_path);  // a log left by an earlier run would replay onto the new store
+
+	constexpr uint stat_count = 64, update_count = 10000;
+	{
+		BlockManager manager(std::move(file));
+		manager.Format();
+		RootRef root = manager;
+		{
+			auto list = root.Write(); list->stat_list.resize(stat_count);
+			for (uint id = 0; id < stat_count; ++id) { list->stat_list[id] = manager; list->stat_list[id].Update({ id, { 0, 0.0 } }); }
+		}
+		manager.SaveRootRef(root);
+	}
+
+	uint64 committed_size = std::filesystem::file_size(path);
+	{
+		BlockManager manager(std::make_unique<FileManager>(path, FileManager::CreateMode::OpenExisting));
+		manager.SetRedoLog(log_path);
+		RootRef root; manager.LoadRootRef(root);
+		auto list = root.Read();
+		for (uint step = 0; step < update_count; ++step) {
+			const BlockRef<Stat>& stat_ref = list->stat_list[step % stat_count];
+			Stat stat = *stat_ref.Read(); stat.counter.hits++; stat.counter.total += step; stat_ref.Update(stat);
+		}
+		{
+			auto held = list->stat_list[0].Read(); Stat stat = *held; stat.counter.hits++; list->stat_list[0].Update(stat);
+			std::cout << "held copy unchanged: " << (held->counter.hits + 1 == list->stat_list[0].Read()->counter.hits) << std::endl;
+			stat.counter.hits--; list->stat_list[0].Update(stat);
+		}
+		std::cout << "redo log bytes before flush: " << std::filesystem::file_size(log_path) << std::endl;
+	}  // no Flush, the next open replays the log
+
+	BlockManager manager(std::make_unique<FileManager>(path, FileManager::CreateMode::OpenExisting));
+	manager.SetRedoLog(log_path);
+	std::cout << "redo log bytes after replay: " << std::filesystem::file_size(log_path) << std::endl;
+	std::cout << "file grew: " << (std::filesystem::file_size(path) != committed_size) << std::endl;
+	RootRef root; manager.LoadRootRef(root);
+	uint mismatch_count = 0;
+	for (uint id = 0; id < stat_count; ++id) {
+		auto stat = root.Read()->stat_list[id].Read();
+		double total = 0; for (uint step = id; step < update_count; step += stat_count) { total += step; }
+		if (stat->id != id || stat->counter.hits != (update_count - id + stat_count - 1) / stat_count || stat->counter.total != total) { mismatch_count++; }
+	}
+	std::cout << "mismatches: " << mismatch_count << std::endl;
+}
@@ -0,0 +1,72 @@
+#include "BlockStore/file_manager.h"
+#include "BlockStore/block_manager.h"
+#include "BlockStore/stl_helper.h"
+
+#include <iostream>
+#include <thread>
+#include <chrono>
+
+
+using namespace BlockStore;
+
+
+struct TreeNode {
+	std::string text;
+	std::vector<BlockRef<TreeNode>> child_list;
+};
+
+constexpr auto layout(layout_type<TreeNode>) { return declare(&TreeNode::text, &TreeNode::child_list); }
+
+using RootRef = BlockRef<TreeNode>;
+
+
+void Build(const RootRef& node_ref, uint partition, uint depth) {
+	auto node = node_ref.Write(); node->text = "partition " + std::to_string(partition) + " node " + std::to_string(depth);
+	for (uint index = 0; depth > 0 && index < 4; ++index) { node->child_list.emplace_back(node_ref.GetManager()); Build(node->child_list.back(), partition, depth - 1); }
+}
+
+uint64 Count(const RootRef& node_ref) {
+	auto node = node_ref.Read(); uint64 count = node->text.size();
+	for (auto& child : node->child_list) { count += Count(child); }
+	return count;
+}
+
+
+int main() {
+	std::unique_ptr<FileManager> file;
+	try {
+		file.reset(new FileManager(L"R:\\writer_test.dat", FileManager::CreateMode::CreateAlways));
+	} catch (std::runtime_error&) {
+		return 0;
+	}
+
+	constexpr uint partition_count = 8, depth = 7;
+	uint64 expected = 0;
+	{
+		BlockManager manager(std::move(file));
+		manager.Format();
+		auto start = std::chrono::steady_clock::now();
+		manager.BeginConcurrentWrite(256 * 1024 * 1024);
+		std::vector<RootRef> sub_root_list(partition_count);
+		std::vector<std::thread> thread_list;
+		for (uint partition = 0; partition < partition_count; ++partition) {
+			thread_list.emplace_back([&, partition]() {
+				BlockManager writer(manager);
+				RootRef sub_root = writer; Build(sub_root, partition, depth);
+				sub_root_list[partition] = writer.SaveSubRootRef(sub_root);
+			});
+		}
+		for (auto& thread : thread_list) { thread.join(); }
+		RootRef root = manager; root.Write()->text = "root"; root.Write()->child_list = sub_root_list;
+		manager.CommitConcurrentWrite(root);
+		std::cout << "concurrent write time: " << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << std::endl;
+		expected = Count(root);
+	}
+
+	BlockManager manager(std::make_unique<FileManager>(L"R:\\writer_test.dat", FileManager::CreateMode::OpenExisting));
+	RootRef root; manager.LoadRootRef(root);
+	BlockCheckResult result = manager.Check(root);
+	std::cout << "reachable blocks: " << result.block_count << std::endl;
+	std::cout << "errors: " << result.error_list.size() << std::endl;
+	std::cout << "total matches: " << (Count(root) == expected) << std::endl;
+}
\ No newline at end of file